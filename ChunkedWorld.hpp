@@ -0,0 +1,331 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Profiler.hpp"
+#include "WorldMap.hpp"
+
+
+namespace GameLogic {
+    /**
+     * A square of SIZE x SIZE map cells, the unit streamed maps are loaded and evicted in.
+     * Like WorldMap it keeps the solid bits, one word per column, apart from the materials.
+     */
+    struct Chunk {
+        static const int BITS = 6;
+        static const int SIZE = 1 << BITS;  // 64 x 64 cells, about 4.5 KB
+        static const int MASK = SIZE - 1;
+
+        uint64_t columns[SIZE] = {};           // Bit y of word x is the solid bit of cell (x, y)
+        uint8_t materials[SIZE * SIZE] = {};   // [x * SIZE + y]
+        mutable std::atomic<unsigned> last_used{ 0 };  // Last frame a ray or collision test read it
+
+        // Cell coordinates are relative to the chunk, 0 to SIZE - 1
+        bool solid(int x, int y) const {
+            return (columns[x] >> y) & 1;
+        }
+
+        int material(int x, int y) const {
+            return materials[x * SIZE + y];
+        }
+
+        void set(int x, int y, int material) {
+            materials[x * SIZE + y] = (uint8_t)material;
+            if (material) columns[x] |= uint64_t(1) << y;
+            else          columns[x] &= ~(uint64_t(1) << y);
+        }
+    };
+
+    /**
+     * Where a streamed map comes from. load() runs on the ChunkCache's loader thread, so it must
+     * not touch anything the game changes while running.
+     */
+    class ChunkSource {
+    public:
+        virtual ~ChunkSource() = default;
+
+        // Size of the map in cells; cells outside it are solid
+        virtual int get_width() const = 0;
+        virtual int get_height() const = 0;
+
+        // Fills an open chunk with the cells of chunk (chunkX, chunkY) that are on the map
+        virtual void load(int chunkX, int chunkY, Chunk& chunk) const = 0;
+    };
+
+    // Streams the chunks of a map held in memory, mostly to check streaming against the plain map
+    class WorldMapChunkSource : public ChunkSource {
+    public:
+        explicit WorldMapChunkSource(WorldMap map)
+            : map(std::move(map)) {}
+
+        int get_width() const override {
+            return map.get_width();
+        }
+
+        int get_height() const override {
+            return map.get_height();
+        }
+
+        void load(int chunkX, int chunkY, Chunk& chunk) const override {
+            const int x0 = chunkX << Chunk::BITS, y0 = chunkY << Chunk::BITS;
+            const int x1 = std::min(x0 + Chunk::SIZE, map.get_width()), y1 = std::min(y0 + Chunk::SIZE, map.get_height());
+            for (int x = x0; x < x1; x++) {
+                for (int y = y0; y < y1; y++) chunk.set(x - x0, y - y0, map.material(x, y));
+            }
+        }
+
+    private:
+        WorldMap map;
+    };
+
+    /**
+     * The loaded chunks of a streamed map. A background thread loads the chunks around the
+     * player and the ones rays cross into, nearest first; chunks nobody read recently are
+     * dropped once the cache holds more than its memory budget.
+     *
+     * lookup(), solid() and material() only read and may run on any number of threads during a
+     * frame. update() adds and drops chunks and must run between frames, when nothing reads.
+     */
+    class ChunkCache {
+    public:
+        /**
+         * @param budget_bytes Memory the chunks may take. Chunks read in the last frame or within
+         *                     load_radius of the player are kept even when that is exceeded.
+         * @param load_radius Chunks within this many chunks of the player are loaded ahead of time.
+         * @param view_radius Rays request the unloaded chunks they cross up to this many chunks away.
+         */
+        ChunkCache(std::unique_ptr<const ChunkSource> source, size_t budget_bytes, int load_radius, int view_radius)
+            : source(std::move(source)), budget_bytes(budget_bytes), load_radius(load_radius),
+              view_radius(std::max(view_radius, load_radius)),
+              chunksX((this->source->get_width() + Chunk::MASK) >> Chunk::BITS),
+              chunksY((this->source->get_height() + Chunk::MASK) >> Chunk::BITS),
+              loader([this]() {
+                  PROFILE_THREAD_NAME("chunk_loader");
+                  load_loop();
+              }) {}
+
+        ~ChunkCache() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            requested.notify_one();
+            loader.join();
+        }
+
+        ChunkCache(const ChunkCache&) = delete;
+        ChunkCache& operator=(const ChunkCache&) = delete;
+
+        /**
+         * Takes in the chunks loaded since the last call, queues the ones around (posX, posY) and
+         * evicts down to the budget. Returns whether chunks were added or dropped, which changes
+         * what rays hit.
+         */
+        bool update(double posX, double posY) {
+            const unsigned drawn = frame++;
+            const int centerX = (int)posX >> Chunk::BITS, centerY = (int)posY >> Chunk::BITS;
+            bool changed = false;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                this->centerX = centerX;
+                this->centerY = centerY;
+                for (auto& arrived : loaded) {
+                    pending.erase(arrived.first);
+                    arrived.second->last_used = frame;
+                    resident[arrived.first] = std::move(arrived.second);
+                    changed = true;
+                }
+                loaded.clear();
+
+                // Requests that fell out of view while queued aren't worth loading any more
+                queue.erase(std::remove_if(queue.begin(), queue.end(), [&](uint64_t key) {
+                    if (distance(key) <= view_radius) return false;
+                    pending.erase(key);
+                    return true;
+                }), queue.end());
+
+                for (int x = centerX - load_radius; x <= centerX + load_radius; x++) {
+                    for (int y = centerY - load_radius; y <= centerY + load_radius; y++) {
+                        if (on_map(x, y) && !resident.count(key_of(x, y))) request_locked(key_of(x, y));
+                    }
+                }
+            }
+            requested.notify_one();
+
+            // Oldest first, and the farthest of chunks last read in the same frame
+            const size_t limit = budget_bytes / sizeof(Chunk);
+            if (resident.size() > limit) {
+                std::vector<std::pair<unsigned, uint64_t>> candidates;
+                for (const auto& entry : resident) {
+                    unsigned used = entry.second->last_used;
+                    if (used != drawn && used != frame && distance(entry.first) > load_radius) {
+                        candidates.push_back({ used, entry.first });
+                    }
+                }
+                std::sort(candidates.begin(), candidates.end(), [this](const auto& a, const auto& b) {
+                    return a.first != b.first ? a.first < b.first : distance(a.second) > distance(b.second);
+                });
+                for (size_t i = 0; i < candidates.size() && resident.size() > limit; i++) {
+                    resident.erase(candidates[i].second);
+                    evictions++;
+                    changed = true;
+                }
+            }
+            return changed;
+        }
+
+        /**
+         * The chunk if it is loaded, else nullptr after requesting it. Marks it as read this frame.
+         * Chunk coordinates must be on the map.
+         */
+        const Chunk* lookup(int chunkX, int chunkY) const {
+            auto it = resident.find(key_of(chunkX, chunkY));
+            if (it == resident.end()) {
+                request(chunkX, chunkY);
+                return nullptr;
+            }
+            const Chunk* chunk = it->second.get();
+            if (chunk->last_used.load(std::memory_order_relaxed) != frame) chunk->last_used.store(frame, std::memory_order_relaxed);
+            return chunk;
+        }
+
+        // Cells off the map and in chunks that aren't loaded yet count as solid, so nothing walks into them
+        bool solid(int x, int y) const {
+            if ((unsigned)x >= (unsigned)get_width() || (unsigned)y >= (unsigned)get_height()) return true;
+            const Chunk* chunk = lookup(x >> Chunk::BITS, y >> Chunk::BITS);
+            return !chunk || chunk->solid(x & Chunk::MASK, y & Chunk::MASK);
+        }
+
+        // 0 off the map and in unloaded chunks
+        int material(int x, int y) const {
+            if ((unsigned)x >= (unsigned)get_width() || (unsigned)y >= (unsigned)get_height()) return 0;
+            const Chunk* chunk = lookup(x >> Chunk::BITS, y >> Chunk::BITS);
+            return chunk ? chunk->material(x & Chunk::MASK, y & Chunk::MASK) : 0;
+        }
+
+        // Blocks until every queued chunk is loaded; the next update() takes them in
+        void wait_idle() {
+            std::unique_lock<std::mutex> lock(mutex);
+            idle.wait(lock, [this]() { return queue.empty() && !loading; });
+        }
+
+        int get_width() const {
+            return source->get_width();
+        }
+
+        int get_height() const {
+            return source->get_height();
+        }
+
+        size_t resident_count() const {
+            return resident.size();
+        }
+
+        size_t memory_used() const {
+            return resident.size() * sizeof(Chunk);
+        }
+
+        // Chunks loaded and evicted so far
+        long long get_loads() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return loads;
+        }
+
+        long long get_evictions() const {
+            return evictions;
+        }
+
+    private:
+        static uint64_t key_of(int chunkX, int chunkY) {
+            return (uint64_t)(uint32_t)chunkX << 32 | (uint32_t)chunkY;
+        }
+
+        bool on_map(int chunkX, int chunkY) const {
+            return (unsigned)chunkX < (unsigned)chunksX && (unsigned)chunkY < (unsigned)chunksY;
+        }
+
+        // Chebyshev distance of a chunk from the player's, in chunks
+        int distance(uint64_t key) const {
+            int chunkX = (int)(uint32_t)(key >> 32), chunkY = (int)(uint32_t)key;
+            return std::max(std::abs(chunkX - centerX), std::abs(chunkY - centerY));
+        }
+
+        void request(int chunkX, int chunkY) const {
+            uint64_t key = key_of(chunkX, chunkY);
+            if (distance(key) > view_radius) return;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!request_locked(key)) return;
+            }
+            requested.notify_one();
+        }
+
+        bool request_locked(uint64_t key) const {
+            if (!pending.insert(key).second) return false;
+            queue.push_back(key);
+            return true;
+        }
+
+        void load_loop() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                requested.wait(lock, [this]() { return stopping || !queue.empty(); });
+                if (stopping) return;
+
+                // Nearest to the player first
+                auto next = std::min_element(queue.begin(), queue.end(), [this](uint64_t a, uint64_t b) { return distance(a) < distance(b); });
+                uint64_t key = *next;
+                queue.erase(next);
+                loading = true;
+                lock.unlock();
+
+                std::unique_ptr<Chunk> chunk(new Chunk());
+                {
+                    PROFILE_SCOPE("load_chunk");
+                    source->load((int)(uint32_t)(key >> 32), (int)(uint32_t)key, *chunk);
+                }
+
+                lock.lock();
+                loaded.push_back({ key, std::move(chunk) });
+                loads++;
+                loading = false;
+                if (queue.empty()) idle.notify_all();
+            }
+        }
+
+        std::unique_ptr<const ChunkSource> source;
+        size_t budget_bytes;
+        int load_radius;
+        int view_radius;
+        int chunksX, chunksY;
+
+        // Only changed by update(), between frames
+        std::unordered_map<uint64_t, std::unique_ptr<Chunk>> resident;
+        unsigned frame = 1;
+        int centerX = 0, centerY = 0;
+        long long evictions = 0;
+
+        // Shared with the loader thread and requesting rays, under mutex
+        mutable std::mutex mutex;
+        mutable std::condition_variable requested;
+        std::condition_variable idle;
+        mutable std::vector<uint64_t> queue;
+        mutable std::unordered_set<uint64_t> pending;  // Queued, loading or loaded but not taken in yet
+        std::vector<std::pair<uint64_t, std::unique_ptr<Chunk>>> loaded;
+        long long loads = 0;
+        bool loading = false;
+        bool stopping = false;
+
+        std::thread loader;  // Last, so it starts after everything it uses
+    };
+}
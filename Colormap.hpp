@@ -0,0 +1,130 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+
+#include "Pixel.hpp"
+
+
+namespace GraphicsEngine {
+    /**
+     * One shade: blends every channel towards the fog color, c * scale / 256 + fog * (256 - scale) / 256.
+     * Doom's colormaps are tables over palette indices; the textures here are true color, where
+     * the same remap is two integer multiplies on the packed channels, which also vectorize.
+     */
+    struct Colormap {
+        Uint32 scale;   // 0 to 256
+        Uint32 fog_rb;  // Fog red and blue times 256 - scale, packed like the pixel's
+        Uint32 fog_g;   // Fog green times 256 - scale, packed like the pixel's
+
+        Pixel apply(Pixel pixel) const {
+            // No channel's sum exceeds 16 bits, so red and blue share one multiply
+            Uint32 rb = (((pixel & 0x00FF00FFu) * scale + fog_rb) >> 8) & 0x00FF00FFu;
+            Uint32 g = (((pixel & 0x0000FF00u) * scale + fog_g) >> 8) & 0x0000FF00u;
+            return 0xFF000000u | rb | g;
+        }
+    };
+
+    /**
+     * The colormaps of a span of pixels at the same shade. With dithering the shade lies between
+     * two colormaps and each pixel picks one of them from a 4x4 ordered dither pattern.
+     */
+    struct ShadeSpan {
+        const Colormap* nearer;
+        const Colormap* farther;
+        int fraction;  // Pixels whose dither threshold is below this use farther
+
+        // 4x4 Bayer matrix, thresholds 0 to 15
+        static constexpr Uint8 DITHER[4][4] = {
+            {  0,  8,  2, 10 },
+            { 12,  4, 14,  6 },
+            {  3, 11,  1,  9 },
+            { 15,  7, 13,  5 }
+        };
+
+        const Colormap& at(int x, int y) const {
+            return fraction > DITHER[y & 3][x & 3] ? *farther : *nearer;
+        }
+    };
+
+    /**
+     * Doom style light tables, generated once at load: SHADES colormaps that fade from the
+     * plain colors to the fog color, and a light level x distance band table of which shade
+     * to draw a surface with. Renderers look up the shade once per span (a wall column, a
+     * floor row, a sprite), so pixels only cost integer math.
+     */
+    class ColormapTable {
+    public:
+        static constexpr int SHADES = 32;
+        static constexpr int LIGHT_LEVELS = 16;
+        static constexpr int MAX_LIGHT = LIGHT_LEVELS - 1;
+
+        // Distance bands are a quarter cell deep
+        static constexpr int BANDS_PER_CELL = 4;
+        static constexpr int DISTANCE_BANDS = 128;
+
+        // Shades are kept in 1/SUBSHADES steps, the resolution of the dithering
+        static constexpr int SUBSHADES = 16;
+
+        ColormapTable()
+            : ColormapTable(0x000000, 24.0) {}
+
+        /**
+         * @param fog_color Color (0xRRGGBB) everything fades into.
+         * @param fog_distance Distance in cells at which fully lit surfaces have faded into it.
+         */
+        ColormapTable(Uint32 fog_color, double fog_distance)
+            : colormaps(SHADES), shades(LIGHT_LEVELS * DISTANCE_BANDS) {
+            const Uint32 fog_rb = fog_color & 0x00FF00FFu, fog_g = fog_color & 0x0000FF00u;
+            for (int shade = 0; shade < SHADES; shade++) {
+                Colormap& colormap = colormaps[shade];
+                colormap.scale = Uint32(256 - shade * 256 / (SHADES - 1));
+                colormap.fog_rb = fog_rb * (256 - colormap.scale);
+                colormap.fog_g = fog_g * (256 - colormap.scale);
+            }
+
+            // Darkness adds up from the light level, up to half way to the fog, and the distance
+            const double max_shade = (SHADES - 1) * SUBSHADES;
+            for (int light = 0; light < LIGHT_LEVELS; light++) {
+                for (int band = 0; band < DISTANCE_BANDS; band++) {
+                    double distance = (band + 0.5) / BANDS_PER_CELL;
+                    double shade = (MAX_LIGHT - light) * max_shade / (2 * MAX_LIGHT) + distance / fog_distance * max_shade;
+                    shades[light * DISTANCE_BANDS + band] = (int)std::min(shade, max_shade);
+                }
+            }
+        }
+
+        // Shade of a surface in 1/SUBSHADES steps, from 0 (plain color) to (SHADES - 1) * SUBSHADES (fog)
+        int shade(int light, double distance) const {
+            int band = distance < DISTANCE_BANDS / (double)BANDS_PER_CELL ? (int)(distance * BANDS_PER_CELL) : DISTANCE_BANDS - 1;
+            return shades[std::min(std::max(light, 0), MAX_LIGHT) * DISTANCE_BANDS + std::max(band, 0)];
+        }
+
+        // Colormaps of a span at shade; without dithering the nearest colormap is used throughout
+        ShadeSpan span(int shade, bool dither) const {
+            int index = shade / SUBSHADES;
+            if (!dither) {
+                const Colormap* nearest = &colormaps[index + (shade % SUBSHADES > ROUNDING_THRESHOLD ? 1 : 0)];
+                return ShadeSpan{ nearest, nearest, 0 };
+            }
+            return ShadeSpan{ &colormaps[index], &colormaps[std::min(index + 1, SHADES - 1)], shade % SUBSHADES };
+        }
+
+        // Colormap of one pixel at shade, the same choice span() and ShadeSpan::at() make
+        const Colormap& at(int shade, int x, int y, bool dither) const {
+            int threshold = dither ? ShadeSpan::DITHER[y & 3][x & 3] : ROUNDING_THRESHOLD;
+            return colormaps[shade / SUBSHADES + (shade % SUBSHADES > threshold ? 1 : 0)];
+        }
+
+        // Without dithering shades round to the nearest colormap
+        static constexpr int ROUNDING_THRESHOLD = SUBSHADES / 2 - 1;
+
+        // All colormaps, darkest last
+        const Colormap* data() const {
+            return colormaps.data();
+        }
+
+    private:
+        std::vector<Colormap> colormaps;
+        std::vector<int> shades;  // [light][band]
+    };
+}
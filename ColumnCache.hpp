@@ -0,0 +1,114 @@
+#pragma once
+#include <cmath>
+#include <vector>
+
+#include "Raycaster.hpp"
+
+
+namespace GameLogic {
+    /**
+     * Wall hits of the last frame, reused for the columns of the current one where they are
+     * still valid, so a camera that stands still or only turns casts few rays or none.
+     *
+     * Reuse needs the camera at the same position. A ray of the new frame that lies, by angle,
+     * between two rays of the last frame which hit the same side of the same cell hits that
+     * side too: those two rays and the wall bound a triangle that narrows towards the camera
+     * and is less than a cell wide, so no other wall cell fits in it. The distance is then
+     * computed directly from the wall plane. Rays without such a pair, e.g. at wall edges or
+     * in the part of the view that just turned in, are cast as usual.
+     */
+    class ColumnCache {
+    public:
+        /**
+         * Starts a frame: the hits stored during the last one become the reference.
+         * @param enabled False casts every column, e.g. to compare against full casting.
+         */
+        void begin_frame(const Camera& camera, int screen_width, bool enabled) {
+            previous_hits.swap(hits);
+            hits.resize(screen_width);
+
+            mode = Mode::None;
+            if (enabled && valid && camera.posX == last_camera.posX && camera.posY == last_camera.posY) {
+                bool same_view = camera.dirX == last_camera.dirX && camera.dirY == last_camera.dirY &&
+                                 camera.planeX == last_camera.planeX && camera.planeY == last_camera.planeY;
+                mode = same_view && (int)previous_hits.size() == screen_width ? Mode::Identical : Mode::Rotated;
+            }
+
+            // Inverse of the last camera matrix [planeX dirX; planeY dirY], to find rays by angle
+            invDet = 1.0 / (last_camera.planeX * last_camera.dirY - last_camera.dirX * last_camera.planeY);
+            previous_camera = last_camera;
+            last_camera = camera;
+            valid = true;
+        }
+
+        // Forgets the stored hits, e.g. after the map changed
+        void invalidate() {
+            valid = false;
+        }
+
+        /**
+         * Fills hit for column x from the last frame if it can.
+         * @return False if the column has to be cast.
+         */
+        bool reuse(const Camera& camera, const RayTable& rays, int x, RayHit& hit) const {
+            if (mode == Mode::Identical) {
+                hit = previous_hits[x];
+                return true;
+            }
+            if (mode != Mode::Rotated) return false;
+
+            // The ray in the last camera's space: a * plane + b * dir
+            const double rayDirX = rays.ray_dir_x()[x], rayDirY = rays.ray_dir_y()[x];
+            double a = invDet * (previous_camera.dirY * rayDirX - previous_camera.dirX * rayDirY);
+            double b = invDet * (-previous_camera.planeY * rayDirX + previous_camera.planeX * rayDirY);
+            if (!(b > 0)) return false;
+
+            // Last frame's columns on both sides, same cameraX as RayTable used for them
+            const int width = (int)previous_hits.size();
+            double cameraX = a / b;
+            double column = (cameraX + 1) * width / 2;
+            if (!(column >= 0 && column < width - 1)) return false;
+            int left = (int)column;
+            if (cameraX < 2 * left / (double)width - 1 || cameraX > 2 * (left + 1) / (double)width - 1) return false;
+
+            const RayHit& h0 = previous_hits[left];
+            const RayHit& h1 = previous_hits[left + 1];
+            if (h0.mapX != h1.mapX || h0.mapY != h1.mapY || h0.side != h1.side) return false;
+
+            // Distance to the side of the cell that faces the camera, in the same units as the DDA's
+            double distance;
+            if (h0.side == 0) {
+                double wallX = camera.posX < h0.mapX ? h0.mapX : h0.mapX + 1.0;
+                distance = (wallX - camera.posX) / rayDirX;
+            }
+            else {
+                double wallY = camera.posY < h0.mapY ? h0.mapY : h0.mapY + 1.0;
+                distance = (wallY - camera.posY) / rayDirY;
+            }
+            if (!(distance > 0 && std::isfinite(distance))) return false;
+
+            hit = RayHit{ h0.mapX, h0.mapY, h0.side, 0, distance };
+            return true;
+        }
+
+        // Records the hit of column x of the current frame; bands may store concurrently
+        void store(int x, const RayHit& hit) {
+            hits[x] = hit;
+        }
+
+    private:
+        enum class Mode {
+            None,       // Cast every column
+            Identical,  // Same camera as last frame, every hit is reused as is
+            Rotated     // Same position, hits are reused by angle where possible
+        };
+
+        std::vector<RayHit> hits;
+        std::vector<RayHit> previous_hits;
+        Camera last_camera{};      // Camera of the frame being drawn
+        Camera previous_camera{};  // Camera previous_hits were cast from
+        double invDet = 0;
+        bool valid = false;
+        Mode mode = Mode::None;
+    };
+}
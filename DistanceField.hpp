@@ -0,0 +1,91 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "WorldMap.hpp"
+
+
+namespace GameLogic {
+    /**
+     * Chebyshev distance from every cell to the nearest solid one, for empty-space skipping:
+     * a cell at distance d has only open cells within d - 1 cells of it along both axes, so a
+     * ray can cross that square in one jump. Cells off the map count as solid, so jumps never
+     * leave it. Distances are capped at MAX_DISTANCE and stored in the map's layout, either
+     * owned or viewed like a mapped WorldMap's grids.
+     */
+    class DistanceField {
+    public:
+        static constexpr int MAX_DISTANCE = 64;
+
+        DistanceField() = default;
+
+        explicit DistanceField(const WorldMap& map) {
+            const int width = map.get_width(), height = map.get_height();
+            std::vector<uint8_t> field((size_t)width * height);  // Row-major while it is computed
+            auto at = [&](int x, int y) -> int {
+                if (x < 0 || y < 0 || x >= width || y >= height) return 0;
+                return field[(size_t)x * height + y];
+            };
+
+            // Two chamfer passes with unit weights to all 8 neighbors give the exact Chebyshev distance
+            for (int x = 0; x < width; x++) {
+                for (int y = 0; y < height; y++) {
+                    int d = 0;
+                    if (!map.solid(x, y)) {
+                        d = std::min({ at(x - 1, y - 1), at(x - 1, y), at(x - 1, y + 1), at(x, y - 1) }) + 1;
+                        d = std::min(d, MAX_DISTANCE);
+                    }
+                    field[(size_t)x * height + y] = (uint8_t)d;
+                }
+            }
+            for (int x = width - 1; x >= 0; x--) {
+                for (int y = height - 1; y >= 0; y--) {
+                    int d = at(x, y);
+                    if (d == 0) continue;
+                    d = std::min({ d, at(x + 1, y + 1) + 1, at(x + 1, y) + 1, at(x + 1, y - 1) + 1, at(x, y + 1) + 1 });
+                    field[(size_t)x * height + y] = (uint8_t)d;
+                }
+            }
+
+            map.with_layout([&](const auto& layout) {
+                distances.assign(layout.size(), 0);
+                for (int x = 0; x < width; x++) {
+                    for (int y = 0; y < height; y++) distances[layout.index(x, y)] = field[(size_t)x * height + y];
+                }
+            });
+            cells = distances.data();
+        }
+
+        // View of the map's cell_count() distances stored elsewhere, kept alive by owner
+        DistanceField(const uint8_t* cells, std::shared_ptr<const void> owner)
+            : cells(cells), owner(std::move(owner)) {}
+
+        DistanceField(const DistanceField& other)
+            : distances(other.distances), cells(other.owner ? other.cells : distances.data()), owner(other.owner) {}
+
+        DistanceField& operator=(const DistanceField& other) {
+            DistanceField copy(other);
+            return *this = std::move(copy);
+        }
+
+        DistanceField(DistanceField&&) = default;
+        DistanceField& operator=(DistanceField&&) = default;
+
+        // Distance of a cell by its index in the map's layout
+        int at_cell(size_t cell) const {
+            return cells[cell];
+        }
+
+        // All distances in the map's layout
+        const uint8_t* data() const {
+            return cells;
+        }
+
+    private:
+        std::vector<uint8_t> distances;
+        const uint8_t* cells = nullptr;  // distances, or the viewed ones
+        std::shared_ptr<const void> owner;
+    };
+}
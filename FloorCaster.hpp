@@ -0,0 +1,293 @@
+#pragma once
+#include <stdexcept>
+
+#include "Colormap.hpp"
+#include "GraphicsEngine.hpp"
+#include "LightMap.hpp"
+#include "Raycaster.hpp"
+#include "Simd.hpp"
+#include "Texture.hpp"
+
+
+namespace GameLogic {
+    /**
+     * Horizontal floor and ceiling casting.
+     * All pixels of a floor row lie at the same distance from the camera, so a row only needs that
+     * distance and the world position of its left end; the pixels across it step linearly. The
+     * ceiling row mirrored across the horizon has the same world positions.
+     * Positions are stepped in float as x * step from the row start, so every kernel computes the
+     * same texels as the scalar loop.
+     */
+    class FloorCaster {
+    public:
+        // Pixels per packet of each kernel
+        static const int SSE2_LANES = 4;
+        static const int AVX2_LANES = 8;
+
+        // Unlike the DDA, the floor is straight line code that gains from every SIMD width
+        static GraphicsEngine::SimdLevel default_kernel() {
+            return GraphicsEngine::detect_simd_level();
+        }
+
+        /**
+         * Both textures must be squares of the same power of two size, so texel coordinates
+         * wrap with a mask.
+         */
+        FloorCaster(const GraphicsEngine::Texture& floor, const GraphicsEngine::Texture& ceiling)
+            : floor(floor.column(0)), ceiling(ceiling.column(0)), size(floor.get_width()) {
+            if (!compatible(floor, ceiling)) {
+                throw std::runtime_error("Floor and ceiling textures must be squares of the same power of two size");
+            }
+            mask = size - 1;
+            shift = 0;
+            while ((1 << shift) < size) shift++;
+        }
+
+        static bool compatible(const GraphicsEngine::Texture& floor, const GraphicsEngine::Texture& ceiling) {
+            return GraphicsEngine::Texture::is_power_of_two(floor.get_width()) && floor.get_width() == floor.get_height()
+                && ceiling.get_width() == floor.get_width() && ceiling.get_height() == floor.get_height();
+        }
+
+        /**
+         * Shades floor and ceiling through colormaps, by row distance and by the light level of the
+         * cell under each pixel. Without colormaps they are only drawn at half brightness.
+         */
+        void set_shading(const GraphicsEngine::ColormapTable* new_colormaps, const LightMap* new_lights, bool new_dither) {
+            colormaps = new_colormaps;
+            lights = new_lights;
+            dither = new_dither;
+        }
+
+        // Floor rows below the horizon, the unit draw_rows works in
+        static int row_count(int screen_height) {
+            return screen_height - screen_height / 2;
+        }
+
+        /**
+         * Draws the floor rows [row_begin, row_end), counted down from the horizon, and the
+         * ceiling rows mirrored to them.
+         */
+        void draw_rows(const Camera& camera, GraphicsEngine::FrameBuffer& frame, int row_begin, int row_end,
+                       GraphicsEngine::SimdLevel level) const {
+            const int width = frame.get_width(), height = frame.get_height();
+
+            // Rays through the left and right screen edges
+            const double rayDirX0 = camera.dirX - camera.planeX, rayDirY0 = camera.dirY - camera.planeY;
+            const double rayDirX1 = camera.dirX + camera.planeX, rayDirY1 = camera.dirY + camera.planeY;
+
+            // Camera height, half way between floor and ceiling
+            const double posZ = 0.5 * height;
+
+            for (int row = row_begin; row < row_end; row++) {
+                int y = height / 2 + row;
+                // Distance of the row, taken through the pixel center so the first row stays finite
+                double rowDistance = posZ / (row + 0.5);
+
+                // The row is at one distance, so there is a shade per light level
+                alignas(32) int shades[GraphicsEngine::ColormapTable::LIGHT_LEVELS];
+                if (colormaps) {
+                    for (int light = 0; light < GraphicsEngine::ColormapTable::LIGHT_LEVELS; light++) {
+                        shades[light] = colormaps->shade(light, rowDistance);
+                    }
+                }
+
+                RowSpan span;
+                span.shades = colormaps ? shades : nullptr;
+                span.y = y;
+                span.ceiling_y = height - 1 - y;
+                span.floorX = float(camera.posX + rowDistance * rayDirX0);
+                span.floorY = float(camera.posY + rowDistance * rayDirY0);
+                span.stepX = float(rowDistance * (rayDirX1 - rayDirX0) / width);
+                span.stepY = float(rowDistance * (rayDirY1 - rayDirY0) / width);
+                span.floor_row = frame.data() + (size_t)y * width;
+                span.ceiling_row = frame.data() + (size_t)(height - 1 - y) * width;
+
+                int x = 0;
+#ifdef COOLGAME_X86
+                if (level == GraphicsEngine::SimdLevel::AVX2) {
+                    for (; x + AVX2_LANES <= width; x += AVX2_LANES) draw_packet_avx2(span, x);
+                }
+                else if (level == GraphicsEngine::SimdLevel::SSE2) {
+                    for (; x + SSE2_LANES <= width; x += SSE2_LANES) draw_packet_sse2(span, x);
+                }
+#endif
+                for (; x < width; x++) {
+                    // Kept as separate statements so no compiler fuses them into an FMA the SIMD paths don't use
+                    float dx = span.stepX * float(x);
+                    float dy = span.stepY * float(x);
+                    float worldX = span.floorX + dx;
+                    float worldY = span.floorY + dy;
+                    int texX = int(worldX * size), texY = int(worldY * size);
+                    int index = ((texX & mask) << shift) | (texY & mask);
+                    if (span.shades) {
+                        store_shaded(span, x, index, texX >> shift, texY >> shift);
+                        continue;
+                    }
+                    span.floor_row[x] = dim(floor[index]);
+                    span.ceiling_row[x] = dim(ceiling[index]);
+                }
+            }
+        }
+
+    private:
+        struct RowSpan {
+            float floorX, floorY;
+            float stepX, stepY;
+            Uint32* floor_row;
+            Uint32* ceiling_row;
+            int y, ceiling_y;
+            const int* shades;  // Per light level, nullptr when unshaded
+        };
+
+        // Floors and ceilings are drawn at half brightness, like the y sides of walls
+        static Uint32 dim(Uint32 texel) {
+            return 0xFF000000u | ((texel >> 1) & 0x007F7F7Fu);
+        }
+
+        // Pixel x of both rows, shaded for the light of the cell under it
+        void store_shaded(const RowSpan& span, int x, int index, int cellX, int cellY) const {
+            int shade = span.shades[lights->level(cellX, cellY)];
+            span.floor_row[x] = colormaps->at(shade, x, span.y, dither).apply(dim(floor[index]));
+            span.ceiling_row[x] = colormaps->at(shade, x, span.ceiling_y, dither).apply(dim(ceiling[index]));
+        }
+
+#ifdef COOLGAME_X86
+        // 8 pixels at a time, texels fetched with gathers from the transposed textures
+        COOLGAME_TARGET("avx2")
+        void draw_packet_avx2(const RowSpan& span, int x) const {
+            __m256 xs = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+            __m256 worldX = _mm256_add_ps(_mm256_set1_ps(span.floorX), _mm256_mul_ps(_mm256_set1_ps(span.stepX), xs));
+            __m256 worldY = _mm256_add_ps(_mm256_set1_ps(span.floorY), _mm256_mul_ps(_mm256_set1_ps(span.stepY), xs));
+
+            const __m256 vSize = _mm256_set1_ps((float)size);
+            const __m256i vMask = _mm256_set1_epi32(mask);
+            __m256i fullX = _mm256_cvttps_epi32(_mm256_mul_ps(worldX, vSize));
+            __m256i fullY = _mm256_cvttps_epi32(_mm256_mul_ps(worldY, vSize));
+            __m256i texX = _mm256_and_si256(fullX, vMask);
+            __m256i texY = _mm256_and_si256(fullY, vMask);
+            __m256i index = _mm256_or_si256(_mm256_sll_epi32(texX, _mm_cvtsi32_si128(shift)), texY);
+
+            const __m256i opaque = _mm256_set1_epi32((int)0xFF000000u);
+            const __m256i halfMask = _mm256_set1_epi32(0x007F7F7F);
+            __m256i floorTexel = _mm256_i32gather_epi32((const int*)floor, index, 4);
+            __m256i ceilingTexel = _mm256_i32gather_epi32((const int*)ceiling, index, 4);
+            floorTexel = _mm256_or_si256(opaque, _mm256_and_si256(_mm256_srli_epi32(floorTexel, 1), halfMask));
+            ceilingTexel = _mm256_or_si256(opaque, _mm256_and_si256(_mm256_srli_epi32(ceilingTexel, 1), halfMask));
+
+            if (span.shades) {
+                // Light level of the cell under each pixel, the ambient level off the map
+                __m256i cellX = _mm256_sra_epi32(fullX, _mm_cvtsi32_si128(shift));
+                __m256i cellY = _mm256_sra_epi32(fullY, _mm_cvtsi32_si128(shift));
+                const __m256i zero = _mm256_setzero_si256();
+                const __m256i mapWidth = _mm256_set1_epi32(lights->get_map_width());
+                const __m256i mapHeight = _mm256_set1_epi32(lights->get_map_height());
+                __m256i onMap = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpgt_epi32(zero, cellX), _mm256_cmpgt_epi32(zero, cellY)),
+                                                    _mm256_and_si256(_mm256_cmpgt_epi32(mapWidth, cellX), _mm256_cmpgt_epi32(mapHeight, cellY)));
+                __m256i cell = _mm256_and_si256(onMap, _mm256_add_epi32(_mm256_mullo_epi32(cellX, mapHeight), cellY));
+                __m256i light = _mm256_mask_i32gather_epi32(_mm256_set1_epi32(lights->get_ambient()), lights->data(), cell, onMap, 4);
+
+                // Mostly the whole packet lies in cells of one light level and the colormaps need no gathers
+                int light0 = _mm256_cvtsi256_si32(light);
+                bool uniform = _mm256_movemask_epi8(_mm256_cmpeq_epi32(light, _mm256_set1_epi32(light0))) == -1;
+                __m256i shade = uniform ? _mm256_set1_epi32(span.shades[light0]) : _mm256_i32gather_epi32(span.shades, light, 4);
+                floorTexel = shade_packet_avx2(floorTexel, shade, uniform, span.y);
+                ceilingTexel = shade_packet_avx2(ceilingTexel, shade, uniform, span.ceiling_y);
+            }
+
+            _mm256_storeu_si256((__m256i*)(span.floor_row + x), floorTexel);
+            _mm256_storeu_si256((__m256i*)(span.ceiling_row + x), ceilingTexel);
+        }
+
+        // Colormap::apply of ColormapTable::at for 8 pixels of row y, starting at a multiple of 8
+        COOLGAME_TARGET("avx2")
+        __m256i shade_packet_avx2(__m256i texel, __m256i shade, bool uniform, int y) const {
+            using GraphicsEngine::Colormap;
+            using GraphicsEngine::ColormapTable;
+            using GraphicsEngine::ShadeSpan;
+            static_assert(ColormapTable::SUBSHADES == 16, "Shades are split with a shift by 4");
+            static_assert(sizeof(Colormap) == 3 * sizeof(int), "Colormaps are gathered as 3 ints");
+
+            const Uint8* dither_row = ShadeSpan::DITHER[y & 3];
+            __m256i threshold = dither ? _mm256_setr_epi32(dither_row[0], dither_row[1], dither_row[2], dither_row[3],
+                                                           dither_row[0], dither_row[1], dither_row[2], dither_row[3])
+                                       : _mm256_set1_epi32(ColormapTable::ROUNDING_THRESHOLD);
+            __m256i fraction = _mm256_and_si256(shade, _mm256_set1_epi32(ColormapTable::SUBSHADES - 1));
+            __m256i farther = _mm256_cmpgt_epi32(fraction, threshold);
+
+            __m256i scale, fogRB, fogG;
+            if (uniform) {
+                // Every lane picks between the same two colormaps
+                int index = _mm256_cvtsi256_si32(shade) / ColormapTable::SUBSHADES;
+                const Colormap& a = colormaps->data()[index];
+                const Colormap& b = colormaps->data()[std::min(index + 1, ColormapTable::SHADES - 1)];
+                scale = _mm256_blendv_epi8(_mm256_set1_epi32((int)a.scale), _mm256_set1_epi32((int)b.scale), farther);
+                fogRB = _mm256_blendv_epi8(_mm256_set1_epi32((int)a.fog_rb), _mm256_set1_epi32((int)b.fog_rb), farther);
+                fogG = _mm256_blendv_epi8(_mm256_set1_epi32((int)a.fog_g), _mm256_set1_epi32((int)b.fog_g), farther);
+            }
+            else {
+                __m256i index = _mm256_sub_epi32(_mm256_srli_epi32(shade, 4), farther);
+                __m256i offset = _mm256_add_epi32(index, _mm256_add_epi32(index, index));
+                const int* base = (const int*)colormaps->data();
+                scale = _mm256_i32gather_epi32(base, offset, 4);
+                fogRB = _mm256_i32gather_epi32(base + 1, offset, 4);
+                fogG = _mm256_i32gather_epi32(base + 2, offset, 4);
+            }
+            fogG = _mm256_srli_epi32(fogG, 8);
+
+            // Every channel in its own 16 bits, where channel * scale + fog never carries over
+            const __m256i lowBytes = _mm256_set1_epi32(0x00FF00FF);
+            __m256i scale16 = _mm256_or_si256(scale, _mm256_slli_epi32(scale, 16));
+            __m256i rb = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_and_si256(texel, lowBytes), scale16), fogRB), 8);
+            __m256i g = _mm256_add_epi32(_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(texel, 8), _mm256_set1_epi32(0xFF)), scale), fogG);
+            g = _mm256_and_si256(g, _mm256_set1_epi32(0x0000FF00));
+            return _mm256_or_si256(_mm256_set1_epi32((int)0xFF000000u), _mm256_or_si256(rb, g));
+        }
+
+        // Same as draw_packet_avx2 with 4 pixels and scalar texel loads instead of gathers
+        COOLGAME_TARGET("sse2")
+        void draw_packet_sse2(const RowSpan& span, int x) const {
+            __m128 xs = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x), _mm_setr_epi32(0, 1, 2, 3)));
+            __m128 worldX = _mm_add_ps(_mm_set1_ps(span.floorX), _mm_mul_ps(_mm_set1_ps(span.stepX), xs));
+            __m128 worldY = _mm_add_ps(_mm_set1_ps(span.floorY), _mm_mul_ps(_mm_set1_ps(span.stepY), xs));
+
+            const __m128 vSize = _mm_set1_ps((float)size);
+            const __m128i vMask = _mm_set1_epi32(mask);
+            __m128i fullX = _mm_cvttps_epi32(_mm_mul_ps(worldX, vSize));
+            __m128i fullY = _mm_cvttps_epi32(_mm_mul_ps(worldY, vSize));
+            __m128i texX = _mm_and_si128(fullX, vMask);
+            __m128i texY = _mm_and_si128(fullY, vMask);
+
+            alignas(16) int index[SSE2_LANES];
+            _mm_store_si128((__m128i*)index, _mm_or_si128(_mm_sll_epi32(texX, _mm_cvtsi32_si128(shift)), texY));
+
+            if (span.shades) {
+                alignas(16) int cellX[SSE2_LANES], cellY[SSE2_LANES];
+                _mm_store_si128((__m128i*)cellX, _mm_sra_epi32(fullX, _mm_cvtsi32_si128(shift)));
+                _mm_store_si128((__m128i*)cellY, _mm_sra_epi32(fullY, _mm_cvtsi32_si128(shift)));
+                for (int i = 0; i < SSE2_LANES; i++) store_shaded(span, x + i, index[i], cellX[i], cellY[i]);
+                return;
+            }
+
+            const __m128i opaque = _mm_set1_epi32((int)0xFF000000u);
+            const __m128i halfMask = _mm_set1_epi32(0x007F7F7F);
+            __m128i floorTexel = _mm_setr_epi32((int)floor[index[0]], (int)floor[index[1]], (int)floor[index[2]], (int)floor[index[3]]);
+            __m128i ceilingTexel = _mm_setr_epi32((int)ceiling[index[0]], (int)ceiling[index[1]], (int)ceiling[index[2]], (int)ceiling[index[3]]);
+            floorTexel = _mm_or_si128(opaque, _mm_and_si128(_mm_srli_epi32(floorTexel, 1), halfMask));
+            ceilingTexel = _mm_or_si128(opaque, _mm_and_si128(_mm_srli_epi32(ceilingTexel, 1), halfMask));
+            _mm_storeu_si128((__m128i*)(span.floor_row + x), floorTexel);
+            _mm_storeu_si128((__m128i*)(span.ceiling_row + x), ceilingTexel);
+        }
+#endif
+
+        // Transposed texels, texel (x, y) at (x << shift) | y
+        const Uint32* floor;
+        const Uint32* ceiling;
+        int size;
+        int mask;
+        int shift;
+
+        const GraphicsEngine::ColormapTable* colormaps = nullptr;
+        const LightMap* lights = nullptr;
+        bool dither = false;
+    };
+}
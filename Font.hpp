@@ -0,0 +1,104 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <string>
+
+#include <SDL2/SDL_stdinc.h>
+
+
+namespace GraphicsEngine {
+    /**
+     * Tiny 3x5 bitmap font for debug text drawn straight into a 32-bit pixel buffer.
+     * Covers digits, upper case letters (lower case is drawn as upper case) and a few symbols.
+     */
+    class DebugFont {
+    public:
+        static const int GLYPH_WIDTH = 3;
+        static const int GLYPH_HEIGHT = 5;
+
+        // Horizontal and vertical advance per character at the given scale
+        static int advance(int scale) {
+            return (GLYPH_WIDTH + 1) * scale;
+        }
+
+        static int line_height(int scale) {
+            return (GLYPH_HEIGHT + 2) * scale;
+        }
+
+        /**
+         * Draws text with its top left corner at (x, y). Pixels outside the buffer are skipped.
+         * @param scale Size of one font pixel in screen pixels.
+         */
+        static void draw_text(Uint32* pixels, int width, int height, int x, int y,
+                              const std::string& text, Uint32 pixel, int scale = 2) {
+            for (char c : text) {
+                unsigned short bits = glyph(c);
+                for (int row = 0; row < GLYPH_HEIGHT; row++) {
+                    for (int col = 0; col < GLYPH_WIDTH; col++) {
+                        // Bit 14 is the top left pixel, rows are stored top to bottom
+                        if (!(bits & (1 << (14 - row * GLYPH_WIDTH - col)))) continue;
+
+                        for (int sy = 0; sy < scale; sy++) {
+                            int py = y + row * scale + sy;
+                            if (py < 0 || py >= height) continue;
+                            for (int sx = 0; sx < scale; sx++) {
+                                int px = x + col * scale + sx;
+                                if (px < 0 || px >= width) continue;
+                                pixels[(size_t)py * width + px] = pixel;
+                            }
+                        }
+                    }
+                }
+                x += advance(scale);
+            }
+        }
+
+        // Halves the brightness of a rectangle so text on top of it stays readable
+        static void darken_rect(Uint32* pixels, int width, int height, int x, int y, int w, int h) {
+            int x_end = std::min(x + w, width), y_end = std::min(y + h, height);
+            for (int py = std::max(y, 0); py < y_end; py++) {
+                for (int px = std::max(x, 0); px < x_end; px++) {
+                    Uint32& p = pixels[(size_t)py * width + px];
+                    p = 0xFF000000u | ((p >> 1) & 0x007F7F7Fu);
+                }
+            }
+        }
+
+    private:
+        static unsigned short glyph(char c) {
+            c = (char)std::toupper((unsigned char)c);
+            if (c >= '0' && c <= '9') return DIGITS[c - '0'];
+            if (c >= 'A' && c <= 'Z') return LETTERS[c - 'A'];
+
+            switch (c) {
+            case '.': return 0b000'000'000'000'010;
+            case ',': return 0b000'000'000'010'100;
+            case ':': return 0b000'010'000'010'000;
+            case '-': return 0b000'000'111'000'000;
+            case '_': return 0b000'000'000'000'111;
+            case '/': return 0b001'001'010'100'100;
+            case '%': return 0b101'001'010'100'101;
+            case '(': return 0b010'100'100'100'010;
+            case ')': return 0b010'001'001'001'010;
+            case '=': return 0b000'111'000'111'000;
+            default:  return 0;  // Space and unknown characters
+            }
+        }
+
+        static constexpr unsigned short DIGITS[10] = {
+            0b111'101'101'101'111, 0b010'110'010'010'111, 0b111'001'111'100'111, 0b111'001'111'001'111,
+            0b101'101'111'001'001, 0b111'100'111'001'111, 0b111'100'111'101'111, 0b111'001'001'001'001,
+            0b111'101'111'101'111, 0b111'101'111'001'111
+        };
+
+        static constexpr unsigned short LETTERS[26] = {
+            0b010'101'111'101'101, 0b110'101'110'101'110, 0b011'100'100'100'011, 0b110'101'101'101'110,  // A B C D
+            0b111'100'110'100'111, 0b111'100'110'100'100, 0b011'100'101'101'011, 0b101'101'111'101'101,  // E F G H
+            0b111'010'010'010'111, 0b001'001'001'101'010, 0b101'101'110'101'101, 0b100'100'100'100'111,  // I J K L
+            0b101'111'111'101'101, 0b110'101'101'101'101, 0b010'101'101'101'010, 0b110'101'110'100'100,  // M N O P
+            0b010'101'101'110'011, 0b110'101'110'101'101, 0b011'100'010'001'110, 0b111'010'010'010'010,  // Q R S T
+            0b101'101'101'101'111, 0b101'101'101'101'010, 0b101'101'111'111'101, 0b101'101'010'101'101,  // U V W X
+            0b101'101'010'010'010, 0b111'001'010'100'111                                                // Y Z
+        };
+    };
+}
@@ -1,8 +1,11 @@
 #pragma once
 #define SDL_MAIN_HANDLED
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <atomic>
 #include <cmath>
+#include <memory>
 
 #include <vector>
 #include <unordered_map>
@@ -17,108 +20,511 @@
 
 #include "Settings.hpp"
 #include "GraphicsEngine.hpp"
+#include "ChunkedWorld.hpp"
+#include "ColumnCache.hpp"
+#include "DistanceField.hpp"
+#include "FloorCaster.hpp"
+#include "LightMap.hpp"
+#include "MapFile.hpp"
+#include "Raycaster.hpp"
+#include "Sprites.hpp"
+#include "Texture.hpp"
+#include "WorldMap.hpp"
 
 
 namespace GameLogic {
     class Game : public GraphicsEngine::Window {
     public:
-        Game(int width, int height, std::string title)
-             : GraphicsEngine::Window(width, height, title) {
+        /**
+         * @param level Map file played instead of the built in map if it exists and is valid;
+         *              nullptr always plays the built in map.
+         */
+        Game(int width, int height, std::string title, bool headless = false, const char* level = Settings::LEVEL_FILE)
+             : GraphicsEngine::Window(width, height, title, headless),
+               world(&Settings::worldMap[0][0], Settings::MAP_WIDTH, Settings::MAP_HEIGHT, settings_map_layout()), distance_field(world) {
 
-            for (int i = 0; i < MAP_WIDTH; ++i) {
-                for (int j = 0; j < MAP_HEIGHT; ++j) {
-                    worldMap[i][j] = Settings::worldMap[i][j];
+            set_render_threads(Settings::RENDER_THREADS);
+            set_tick_rate(Settings::TICK_RATE);
+            set_vsync(Settings::VSYNC);
+            set_frame_rate_cap(Settings::FRAME_RATE_CAP);
+            set_pipelined(Settings::PIPELINED_UPDATE);
+            set_frame_time_budget(Settings::FRAME_TIME_BUDGET_MS);
+
+            bool loaded = level && load_map_file(level);
+            load_textures();
+            build_wall_shades();
+
+            // The light sectors and sprites of Settings belong to the built in map; a loaded map has ambient light
+            if (!loaded) {
+                build_light_map();
+                for (const auto& sprite : Settings::sprites) {
+                    sprites.push_back(Sprite{ sprite[0], sprite[1], (int)sprite[2] });
                 }
             }
         }
 
+        // Places the player, e.g. to replay a recorded camera path
+        void set_camera(const Camera& camera) {
+            player = camera;
+
+            // A jump, not a movement, so there is nothing to interpolate from
+            previous_camera = camera;
+        }
+
+        Camera get_camera() const {
+            return player;
+        }
+
+        // Number of threads raycasting each frame, including the main thread (0 = one per hardware thread)
+        void set_render_threads(int thread_count) {
+            workers.set_thread_count(thread_count);
+        }
+
+        int get_render_threads() const {
+            return workers.get_thread_count();
+        }
+
+        // Replaces the sprites in the world; visible from the next published frame on
+        void set_sprites(const std::vector<Sprite>& new_sprites) {
+            sprites = new_sprites;
+        }
+
+        const std::vector<Sprite>& get_sprites() const {
+            return sprites;
+        }
+
         void on_update(double delta_time) override {
+            previous_camera = get_camera();
+
             //speed modifiers
             double moveSpeed = delta_time * 5.0; //the constant value is in squares/second
             double rotSpeed = delta_time * 3.0; //the constant value is in radians/second
 
+            // With a fixed tick the turn per tick never changes, so cos and sin are only
+            // evaluated again when it does (e.g. while ticking at the frame rate)
+            if (rotSpeed != turn_angle) {
+                turn_angle = rotSpeed;
+                turn_cos = cos(rotSpeed);
+                turn_sin = sin(rotSpeed);
+            }
+
+            double& posX = player.posX;
+            double& posY = player.posY;
+            const double dirX = player.dirX, dirY = player.dirY;
+
             //move forward if no wall in front of you
-            if (key_manager.is_key_hold(SDLK_w))
+            if (key_manager.is_key_hold(SDL_SCANCODE_W))
             {
-                if (worldMap[int(posX + dirX * moveSpeed)][int(posY)] == false) posX += dirX * moveSpeed;
-                if (worldMap[int(posX)][int(posY + dirY * moveSpeed)] == false) posY += dirY * moveSpeed;
+                if (!cell_solid(int(posX + dirX * moveSpeed), int(posY))) posX += dirX * moveSpeed;
+                if (!cell_solid(int(posX), int(posY + dirY * moveSpeed))) posY += dirY * moveSpeed;
             }
             //move backwards if no wall behind you
-            if (key_manager.is_key_hold(SDLK_s))
+            if (key_manager.is_key_hold(SDL_SCANCODE_S))
             {
-                if (worldMap[int(posX - dirX * moveSpeed)][int(posY)] == false) posX -= dirX * moveSpeed;
-                if (worldMap[int(posX)][int(posY - dirY * moveSpeed)] == false) posY -= dirY * moveSpeed;
+                if (!cell_solid(int(posX - dirX * moveSpeed), int(posY))) posX -= dirX * moveSpeed;
+                if (!cell_solid(int(posX), int(posY - dirY * moveSpeed))) posY -= dirY * moveSpeed;
             }
             //rotate to the right
-            if (key_manager.is_key_hold(SDLK_d))
+            if (key_manager.is_key_hold(SDL_SCANCODE_D))
             {
-                //both camera direction and camera plane must be rotated
-                double oldDirX = dirX;
-                dirX = dirX * cos(-rotSpeed) - dirY * sin(-rotSpeed);
-                dirY = oldDirX * sin(-rotSpeed) + dirY * cos(-rotSpeed);
-                double oldPlaneX = planeX;
-                planeX = planeX * cos(-rotSpeed) - planeY * sin(-rotSpeed);
-                planeY = oldPlaneX * sin(-rotSpeed) + planeY * cos(-rotSpeed);
+                player.rotate(turn_cos, -turn_sin);
             }
             //rotate to the left
-            if (key_manager.is_key_hold(SDLK_a))
+            if (key_manager.is_key_hold(SDL_SCANCODE_A))
             {
-                //both camera direction and camera plane must be rotated
-                double oldDirX = dirX;
-                dirX = dirX * cos(rotSpeed) - dirY * sin(rotSpeed);
-                dirY = oldDirX * sin(rotSpeed) + dirY * cos(rotSpeed);
-                double oldPlaneX = planeX;
-                planeX = planeX * cos(rotSpeed) - planeY * sin(rotSpeed);
-                planeY = oldPlaneX * sin(rotSpeed) + planeY * cos(rotSpeed);
+                player.rotate(turn_cos, turn_sin);
+            }
+        }
+
+        void on_key_press(SDL_Event e) override {
+            GraphicsEngine::Window::on_key_press(e);
+
+            if (e.key.keysym.scancode == SDL_SCANCODE_T) {
+                set_textured_walls(!textured_walls);
+            }
+            else if (e.key.keysym.scancode == SDL_SCANCODE_F) {
+                set_floor_casting(!floor_casting);
+            }
+            else if (e.key.keysym.scancode == SDL_SCANCODE_M) {
+                set_wall_mipmaps(!wall_mipmaps);
+            }
+            else if (e.key.keysym.scancode == SDL_SCANCODE_I) {
+                set_fixed_point_dda(!fixed_point_dda);
+            }
+            else if (e.key.keysym.scancode == SDL_SCANCODE_K) {
+                set_empty_space_skipping(!empty_space_skipping);
+            }
+            else if (e.key.keysym.scancode == SDL_SCANCODE_L) {
+                set_distance_shading(!distance_shading);
+            }
+            else if (e.key.keysym.scancode == SDL_SCANCODE_O) {
+                set_shade_dithering(!shade_dithering);
+            }
+        }
+
+        void on_interpolate(double alpha) override {
+            interpolation_alpha = alpha;
+        }
+
+        // Snapshot of the player and sprites for the renderer. The map only changes between frames, so it is shared as is.
+        // Streamed maps take in the chunks loaded since the last frame here, while nothing reads them.
+        void on_publish() override {
+            render_state.previous = previous_camera;
+            render_state.current = get_camera();
+            render_state.alpha = interpolation_alpha;
+            render_state.sprites = sprites;  // Reuses the capacity of the last frame's copy
+
+            if (chunks && chunks->update(player.posX, player.posY)) {
+                column_cache.invalidate();
+                redraw_requested = true;
             }
         }
 
+        /**
+         * Published camera blended between the last two simulation ticks. Directions are blended
+         * linearly too; per-tick rotations are small enough that the length change is invisible.
+         */
+        Camera get_render_camera() const {
+            const Camera& from = render_state.previous;
+            const Camera& to = render_state.current;
+            const double a = render_state.alpha;
+            auto blend = [a](double from, double to) { return from + (to - from) * a; };
+            return Camera{
+                blend(from.posX, to.posX), blend(from.posY, to.posY),
+                blend(from.dirX, to.dirX), blend(from.dirY, to.dirY),
+                blend(from.planeX, to.planeX), blend(from.planeY, to.planeY)
+            };
+        }
+
+        // Nothing to draw while the camera, the sprites and the render options stay the same (with column reuse on)
+        bool needs_redraw() override {
+            const std::vector<Sprite>& current = render_state.sprites;
+            auto same_sprite = [](const Sprite& a, const Sprite& b) {
+                return a.x == b.x && a.y == b.y && a.texture == b.texture;
+            };
+            const Camera camera = get_render_camera();
+            return redraw_requested || !column_reuse ||
+                camera.posX != drawn_camera.posX || camera.posY != drawn_camera.posY ||
+                camera.dirX != drawn_camera.dirX || camera.dirY != drawn_camera.dirY ||
+                camera.planeX != drawn_camera.planeX || camera.planeY != drawn_camera.planeY ||
+                current.size() != drawn_sprites.size() ||
+                !std::equal(current.begin(), current.end(), drawn_sprites.begin(), same_sprite);
+        }
+
         void on_draw(SDL_Renderer* renderer) {
-            for (int x = 0; x < width; x++) {
-                double cameraX = 2 * x / (double)width - 1;
-                double rayDirX = dirX + planeX * cameraX;
-                double rayDirY = dirY + planeY * cameraX;
-
-                int mapX = (int)posX, mapY = (int)posY;
-
-                // Initialize step and sideDist based on ray direction
-                int stepX = rayDirX < 0 ? -1 : 1;
-                int stepY = rayDirY < 0 ? -1 : 1;
-                double deltaDistX = std::abs(1 / rayDirX);
-                double deltaDistY = std::abs(1 / rayDirY);
-                double sideDistX = stepX == -1 ? (posX - mapX) * deltaDistX : (mapX + 1.0 - posX) * deltaDistX;
-                double sideDistY = stepY == -1 ? (posY - mapY) * deltaDistY : (mapY + 1.0 - posY) * deltaDistY;
-
-                int hit = 0, side;
-                double totalDistance = 0.0;
-
-                // DDA Algorithm
-                while (!hit) {
-                    side = sideDistX < sideDistY ? 0 : 1;
-                    if (side == 0) {
-                        sideDistX += deltaDistX;
-                        mapX += stepX;
-                        totalDistance += deltaDistX;
+            const Camera camera = get_render_camera();
+            const int renderWidth = get_render_width(), renderHeight = get_render_height();
+            drawn_camera = camera;
+            drawn_sprites = render_state.sprites;
+            redraw_requested = false;
+
+            {
+                PROFILE_SCOPE("ray_setup");
+                cast_rays = 0;
+                dda_steps = 0;
+                rays.update(camera, renderWidth);
+                column_cache.begin_frame(camera, renderWidth, column_reuse);
+            }
+
+            // Floor and ceiling first, the walls are drawn over them
+            if (floor_casting) {
+                workers.parallel_for(FloorCaster::row_count(renderHeight), [this, &camera](int row_begin, int row_end) {
+                    draw_floor_rows(camera, row_begin, row_end);
+                });
+            }
+
+            {
+                PROFILE_SCOPE("sprite_sort");
+                sprite_renderer.set_shading(distance_shading ? &colormaps : nullptr, &active_light_map(), shade_dithering);
+                sprite_renderer.project(camera, render_state.sprites.data(), (int)render_state.sprites.size(), renderWidth, renderHeight);
+            }
+
+            // Columns are independent, so the screen is split into bands that are cast in parallel.
+            // Sprites only need the depth of their own columns, so each band draws them right after its walls.
+            workers.parallel_for(renderWidth, [this, &camera](int x_begin, int x_end) {
+                draw_columns(camera, x_begin, x_end);
+
+                PROFILE_SCOPE("sprites");
+                sprite_renderer.draw_columns(framebuffer, zbuffer.data(), x_begin, x_end);
+            });
+        }
+
+        // Casts and rasterizes the screen columns [x_begin, x_end)
+        void draw_columns(const Camera& camera, int x_begin, int x_end) {
+            PROFILE_SCOPE("raycast");
+
+            const int renderHeight = get_render_height();
+            const Raycaster raycaster = chunks ? Raycaster(*chunks) : Raycaster(world, empty_space_skipping ? &distance_field : nullptr);
+
+            // Rays are cast in small batches so the hits stay on the stack
+            RayHit hits[COLUMN_BATCH];
+            long long bandRays = 0, bandSteps = 0;
+            for (int batch = x_begin; batch < x_end; batch += COLUMN_BATCH) {
+                int batch_end = std::min(batch + COLUMN_BATCH, x_end);
+
+                // Runs of columns the last frame's hits can't fill are cast together
+                int x = batch;
+                while (x < batch_end) {
+                    int run_end = x;
+                    while (run_end < batch_end && !column_cache.reuse(camera, rays, run_end, hits[run_end - batch])) run_end++;
+                    if (run_end > x) {
+                        if (fixed_point_dda) raycaster.cast_columns_fixed(camera, rays, x, run_end, hits + (x - batch));
+                        else                 raycaster.cast_columns(camera, rays, x, run_end, hits + (x - batch), ray_kernel);
+                        bandRays += run_end - x;
+                        for (int i = x; i < run_end; i++) bandSteps += hits[i - batch].steps;
                     }
-                    else {
-                        sideDistY += deltaDistY;
-                        mapY += stepY;
-                        totalDistance += deltaDistY;
+                    x = run_end + 1;
+                }
+
+                for (int x = batch; x < batch_end; x++) {
+                    const RayHit& hit = hits[x - batch];
+                    column_cache.store(x, hit);
+                    zbuffer[x] = hit.perpWallDist;
+
+                    // Calculate line height
+                    int lineHeight = renderHeight / hit.perpWallDist;
+
+                    // Draw the wall slice straight into the framebuffer
+                    if (textured_walls) {
+                        draw_textured_slice(camera, x, hit, lineHeight);
+                        continue;
                     }
-                    hit = worldMap[mapX][mapY] > 0;
+                    int drawStart = std::max(-lineHeight / 2 + renderHeight / 2, 0);
+                    int drawEnd = std::min(lineHeight / 2 + renderHeight / 2, renderHeight - 1);
+                    GraphicsEngine::Pixel color = wall_shades.get(wall_index(cell_material(hit.mapX, hit.mapY)), hit.side,
+                                                                  GraphicsEngine::ShadeTable::MAX_BRIGHTNESS);
+                    if (distance_shading) framebuffer.vline_shaded(x, drawStart, drawEnd, color, wall_shade(camera, hit));
+                    else                  framebuffer.vline(x, drawStart, drawEnd, color);
                 }
+            }
+            cast_rays += bandRays;
+            dda_steps += bandSteps;
+            total_cast_rays += bandRays;
+        }
+
+        // Floor rows [row_begin, row_end) below the horizon and the ceiling rows above it
+        void draw_floor_rows(const Camera& camera, int row_begin, int row_end) {
+            PROFILE_SCOPE("floor");
+
+            FloorCaster floorCaster(floor_texture, ceiling_texture);
+            if (distance_shading) floorCaster.set_shading(&colormaps, &active_light_map(), shade_dithering);
+            floorCaster.draw_rows(camera, framebuffer, row_begin, row_end, floor_kernel);
+        }
+
+        // Draws the wall of column x with its texture, y sides darker like the flat colors
+        void draw_textured_slice(const Camera& camera, int x, const RayHit& hit, int lineHeight) {
+            const std::vector<GraphicsEngine::Texture>& mips = wall_mips(cell_material(hit.mapX, hit.mapY));
+
+            // Smallest mip level that still has a texel row per screen row, so far walls read
+            // a few small, cache resident levels instead of skipping through the full texture
+            size_t level = 0;
+            if (wall_mipmaps) {
+                while (level + 1 < mips.size() && mips[level + 1].get_height() >= lineHeight) level++;
+            }
+
+            const GraphicsEngine::Texture& texture = mips[level];
+            const int texWidth = texture.get_width();
+            const int texHeight = texture.get_height();
+
+            const double rayDirX = rays.ray_dir_x()[x], rayDirY = rays.ray_dir_y()[x];
+
+            // Where exactly the wall was hit, as a fraction of the cell
+            double wallX = hit.side == 0 ? camera.posY + hit.perpWallDist * rayDirY : camera.posX + hit.perpWallDist * rayDirX;
+            wallX -= std::floor(wallX);
+
+            // Mirror the texture on walls facing the other way so it never reads backwards
+            int texX = int(wallX * texWidth);
+            if ((hit.side == 0 && rayDirX > 0) || (hit.side == 1 && rayDirY < 0)) texX = texWidth - texX - 1;
+
+            // One division per column, the slice itself is stepped in fixed point.
+            // The span is passed unclipped so texture row 0 stays at the top of the wall.
+            lineHeight = std::max(lineHeight, 1);
+            Uint32 texStep = Uint32((Uint64(texHeight) << GraphicsEngine::Texture::FRACTION_BITS) / lineHeight);
+            const int renderHeight = get_render_height();
+            if (distance_shading) {
+                framebuffer.vline_textured_shaded(x, -lineHeight / 2 + renderHeight / 2, lineHeight / 2 + renderHeight / 2,
+                                                  texture.column(texX), texHeight - 1, 0, texStep, hit.side == 1, wall_shade(camera, hit));
+                return;
+            }
+            framebuffer.vline_textured(x, -lineHeight / 2 + renderHeight / 2, lineHeight / 2 + renderHeight / 2,
+                                       texture.column(texX), texHeight - 1, 0, texStep, hit.side == 1);
+        }
+
+        // Colormaps of a wall column, lit by the open cell in front of the side that was hit
+        GraphicsEngine::ShadeSpan wall_shade(const Camera& camera, const RayHit& hit) const {
+            int cellX = hit.mapX, cellY = hit.mapY;
+            if (hit.side == 0) cellX += camera.posX < hit.mapX ? -1 : 1;
+            else               cellY += camera.posY < hit.mapY ? -1 : 1;
+            return colormaps.span(colormaps.shade(active_light_map().level(cellX, cellY), hit.perpWallDist), shade_dithering);
+        }
+
+        /**
+         * Regenerates the textures at another size, e.g. to benchmark large textures.
+         * Textures loaded from files keep their size. Fails unless size is a power of two.
+         */
+        bool set_texture_size(int size) {
+            if (!GraphicsEngine::Texture::is_power_of_two(size)) return false;
+            texture_size = size;
+            load_textures();
+            redraw_requested = true;
+            return true;
+        }
+
+        int get_texture_size() const {
+            return texture_size;
+        }
+
+        // Sample distant walls from smaller mip levels
+        void set_wall_mipmaps(bool enabled) {
+            wall_mipmaps = enabled;
+            redraw_requested = true;
+        }
+
+        bool get_wall_mipmaps() const {
+            return wall_mipmaps;
+        }
+
+        // Flat colors or textures for the walls
+        void set_textured_walls(bool enabled) {
+            textured_walls = enabled;
+            redraw_requested = true;
+        }
+
+        bool get_textured_walls() const {
+            return textured_walls;
+        }
+
+        // Textured floor and ceiling, or the plain background
+        void set_floor_casting(bool enabled) {
+            floor_casting = enabled;
+            redraw_requested = true;
+        }
+
+        bool get_floor_casting() const {
+            return floor_casting;
+        }
 
-                // Calculate wall distance and line height
-                double wallDist = side == 0 ? (sideDistX - deltaDistX) : (sideDistY - deltaDistY);
-                int lineHeight = height / wallDist;
+        // Selects the DDA and floor kernels, e.g. to compare against the scalar path
+        void set_ray_kernel(GraphicsEngine::SimdLevel level) {
+            ray_kernel = level;
+            floor_kernel = level;
+            redraw_requested = true;
+        }
+
+        GraphicsEngine::SimdLevel get_ray_kernel() const {
+            return ray_kernel;
+        }
+
+        // Reuse last frame's wall hits while the camera only turns, and the whole frame while it stands still
+        void set_column_reuse(bool enabled) {
+            column_reuse = enabled;
+        }
+
+        bool get_column_reuse() const {
+            return column_reuse;
+        }
+
+        // Darken walls, floor and sprites with distance and the light level of their cell
+        void set_distance_shading(bool enabled) {
+            distance_shading = enabled;
+            redraw_requested = true;
+        }
+
+        bool get_distance_shading() const {
+            return distance_shading;
+        }
+
+        // Ordered dithering between the colormaps instead of visible distance bands
+        void set_shade_dithering(bool enabled) {
+            shade_dithering = enabled;
+            redraw_requested = true;
+        }
+
+        bool get_shade_dithering() const {
+            return shade_dithering;
+        }
+
+        // Jump over open space with the distance field instead of stepping every cell
+        void set_empty_space_skipping(bool enabled) {
+            empty_space_skipping = enabled;
+            column_cache.invalidate();  // Jumps change double distances in the last bits
+            redraw_requested = true;
+        }
+
+        bool get_empty_space_skipping() const {
+            return empty_space_skipping;
+        }
+
+        // Rays cast since the game was created; reused columns and frames that weren't redrawn cast none
+        long long get_cast_rays() const {
+            return total_cast_rays;
+        }
+
+        // Average DDA steps of the rays cast for the last frame; reused columns aren't cast
+        double get_steps_per_ray() const {
+            return cast_rays ? dda_steps / (double)cast_rays : 0.0;
+        }
 
-                // Draw the line
-                SDL_Point start = { x, std::max(-lineHeight / 2 + height / 2, 0) };
-                SDL_Point end = { x, std::min(lineHeight / 2 + height / 2, height - 1) };
-                draw->line(start, end, choose_color(worldMap[mapX][mapY], side));
+        // Replaces the map, e.g. to benchmark larger ones; only while no frame is being drawn
+        void set_map(const WorldMap& map) {
+            set_map(map, DistanceField(map));
+        }
+
+        /**
+         * set_map with the map's precomputed distance field, e.g. from a MapFile, and its lights.
+         * Without lights the map gets the ambient light everywhere.
+         */
+        void set_map(const WorldMap& map, const DistanceField& distances, const LightMap& lights = ambient_light_map()) {
+            if (!map.has_solid_border()) throw std::runtime_error("Map border cells must be solid");
+            world = map;
+            distance_field = distances;
+            light_map = lights;
+            column_cache.invalidate();
+            redraw_requested = true;
+        }
+
+        const WorldMap& get_map() const {
+            return world;
+        }
+
+        // Lights of get_map()
+        const LightMap& get_light_map() const {
+            return light_map;
+        }
+
+        /**
+         * Streams the map from source in Chunk sized pieces instead of using get_map(), for maps
+         * too large to keep in memory; nullptr goes back to get_map(). Loaded chunks are kept up
+         * to cache_mb megabytes. Streamed maps have the ambient light everywhere. Only while no
+         * frame is being drawn.
+         */
+        void set_chunk_source(std::unique_ptr<const ChunkSource> source, int cache_mb = Settings::CHUNK_CACHE_MB) {
+            chunks.reset();
+            if (source) {
+                chunks.reset(new ChunkCache(std::move(source), (size_t)cache_mb << 20,
+                                            Settings::CHUNK_LOAD_RADIUS, Settings::CHUNK_VIEW_RADIUS));
             }
+            column_cache.invalidate();
+            redraw_requested = true;
+        }
+
+        // The streamed map's chunks, or nullptr
+        const ChunkCache* get_chunks() const {
+            return chunks.get();
+        }
+
+        // Integer fixed point DDA instead of the double precision kernels, e.g. for replays
+        void set_fixed_point_dda(bool enabled) {
+            fixed_point_dda = enabled;
+            column_cache.invalidate();  // The distances of the two DDAs differ in the last bits
+            redraw_requested = true;
         }
 
+        bool get_fixed_point_dda() const {
+            return fixed_point_dda;
+        }
+
+        // Flat wall color; the renderer reads the same colors from wall_shades
         GraphicsEngine::Color choose_color(int wallType, int side) {
             GraphicsEngine::Color RGB_Red(255, 0, 0, 100);    // Red
             GraphicsEngine::Color RGB_Green(0, 255, 0, 100);  // Green
@@ -142,15 +548,250 @@ namespace GameLogic {
         }
 
     private:
-        // Map
-        static const int MAP_WIDTH = Settings::MAP_WIDTH;
-        static const int MAP_HEIGHT = Settings::MAP_HEIGHT;
-        int worldMap[MAP_WIDTH][MAP_HEIGHT];
-
-        // Player
-        double posX = 22, posY = 12;  //x and y start position
-        double dirX = -1, dirY = 0; //initial direction vector
-        double planeX = 0, planeY = 0.66; //the 2d raycaster version of camera plane
+        void load_textures() {
+            load_wall_textures();
+            load_floor_textures();
+            load_sprite_textures();
+        }
+
+        /**
+         * One texture per wall color of choose_color: a wall<type>.bmp from Settings::TEXTURE_DIRECTORY
+         * when there is one, otherwise a generated pattern in that color. The mip chains are built here.
+         */
+        void load_wall_textures() {
+            const int size = texture_size;
+            const Uint32 tints[WALL_TEXTURE_COUNT] = { 0xFF0000, 0x00FF00, 0x0000FF, 0xFFFFFF, 0xFFFF00 };
+
+            wall_textures.clear();
+            for (int i = 0; i < WALL_TEXTURE_COUNT; i++) {
+                GraphicsEngine::Texture texture;
+                std::string path = std::string(Settings::TEXTURE_DIRECTORY) + "/wall" + std::to_string(i + 1) + ".bmp";
+                if (!GraphicsEngine::Texture::load_bmp(path, texture)) {
+                    texture = generate_texture(i, size, tints[i]);
+                }
+                wall_textures.push_back(texture.build_mip_chain());
+            }
+        }
+
+        /**
+         * floor.bmp and ceiling.bmp from Settings::TEXTURE_DIRECTORY if they are a matching pair
+         * FloorCaster can use, otherwise grey tiles and a dim xor pattern.
+         */
+        void load_floor_textures() {
+            std::string directory = Settings::TEXTURE_DIRECTORY;
+            if (GraphicsEngine::Texture::load_bmp(directory + "/floor.bmp", floor_texture) &&
+                GraphicsEngine::Texture::load_bmp(directory + "/ceiling.bmp", ceiling_texture) &&
+                FloorCaster::compatible(floor_texture, ceiling_texture)) {
+                return;
+            }
+            floor_texture = generate_texture(0, texture_size, 0xA0A0A0);
+            ceiling_texture = generate_texture(1, texture_size, 0x606080);
+        }
+
+        // Barrel, pillar and ceiling lamp on a transparent (black) background
+        void load_sprite_textures() {
+            std::vector<GraphicsEngine::Texture> sprite_textures;
+            const int size = texture_size;
+            auto opaque = [](Uint32 r, Uint32 g, Uint32 b) {
+                return 0xFF000000u | (std::max(r, 1u) << 16) | (g << 8) | b;
+            };
+
+            sprite_textures.push_back(GraphicsEngine::Texture::generate(size, size, [size, opaque](int x, int y) {
+                // Barrel: round body in the lower half, darker hoops
+                double dx = (x + 0.5) / size - 0.5, dy = (y + 0.5) / size - 0.72;
+                if (dx * dx / 0.09 + dy * dy / 0.08 > 1.0) return 0u;
+                Uint32 shade = Uint32(200 - std::abs(dx) * 300);
+                if (std::abs(dy + 0.12) < 0.02 || std::abs(dy - 0.12) < 0.02) shade /= 2;
+                return opaque(shade, shade * 6 / 10, shade / 4);
+            }));
+            sprite_textures.push_back(GraphicsEngine::Texture::generate(size, size, [size, opaque](int x, int y) {
+                // Pillar: a lit column across the full height
+                double dx = (x + 0.5) / size - 0.5;
+                if (std::abs(dx) > 0.16) return 0u;
+                Uint32 shade = Uint32(220 - std::abs(dx + 0.06) * 600);
+                if (y < size / 16 || y >= size - size / 16) shade = 120;
+                return opaque(shade, shade, shade);
+            }));
+            sprite_textures.push_back(GraphicsEngine::Texture::generate(size, size, [size, opaque](int x, int y) {
+                // Lamp: a glowing ball hanging from the ceiling
+                double dx = (x + 0.5) / size - 0.5, dy = (y + 0.5) / size - 0.12;
+                double d = dx * dx + dy * dy;
+                if (d > 0.012) return (std::abs(dx) < 0.01 && dy < 0) ? opaque(60, 60, 60) : 0u;
+                Uint32 glow = Uint32(255 - d * 8000);
+                return opaque(glow * 3 / 4, 255, glow / 3);
+            }));
+            sprite_renderer.set_textures(sprite_textures);
+        }
+
+        // Brick, xor and cross patterns modulating a color
+        static GraphicsEngine::Texture generate_texture(int pattern, int size, Uint32 tint) {
+            return GraphicsEngine::Texture::generate(size, size, [pattern, size, tint](int x, int y) {
+                int brightness;
+                switch (pattern % 3) {
+                case 0: {
+                    // Bricks with mortar lines, every other row shifted by half a brick
+                    int brickHeight = size / 4, brickWidth = size / 2;
+                    int bx = (x + ((y / brickHeight) % 2) * brickWidth / 2) % brickWidth;
+                    brightness = (y % brickHeight == 0 || bx == 0) ? 80 : 200 + ((x * 7 + y * 13) % 56);
+                    break;
+                }
+                case 1:
+                    brightness = 96 + ((x * 256 / size) ^ (y * 256 / size)) * 159 / 255;
+                    break;
+                default:
+                    // Panel with a dark cross, the texture from the classic raycasting tutorials
+                    brightness = (x == y || x == size - y - 1) ? 40 : 160 + y * 95 / size;
+                    break;
+                }
+                Uint32 r = ((tint >> 16) & 0xFF) * brightness / 255;
+                Uint32 g = ((tint >> 8) & 0xFF) * brightness / 255;
+                Uint32 b = (tint & 0xFF) * brightness / 255;
+                return 0xFF000000u | (r << 16) | (g << 8) | b;
+            });
+        }
+
+        // Ambient light everywhere except in the light sectors of Settings
+        void build_light_map() {
+            light_map = LightMap(world.get_width(), world.get_height(), Settings::AMBIENT_LIGHT);
+            for (const auto& sector : Settings::lightSectors) {
+                light_map.fill(sector[0], sector[1], sector[2], sector[3], sector[4]);
+            }
+        }
+
+        // Shades of the flat wall colors, indexed by wall_index
+        void build_wall_shades() {
+            std::vector<GraphicsEngine::Pixel> colors;
+            for (int i = 0; i < WALL_TEXTURE_COUNT; i++) {
+                colors.push_back(choose_color(i + 1, 0).to_pixel());
+            }
+            wall_shades = GraphicsEngine::ShadeTable(colors);
+        }
+
+        // Index of a wall type into wall_textures and wall_shades, with the same fallback as choose_color for unknown types
+        static int wall_index(int wallType) {
+            return (wallType >= 1 && wallType <= WALL_TEXTURE_COUNT ? wallType : WALL_TEXTURE_COUNT) - 1;
+        }
+
+        // Replaces the built in map with the map file at path, used in place, if there is one
+        bool load_map_file(const char* path) {
+            MapFile file;
+            std::string error;
+            if (!MapFile::load(path, file, error)) {
+                if (!error.empty()) std::cout << error << std::endl;
+                return false;
+            }
+            set_map(file.get_map(), file.get_distances());
+            player.posX = file.get_spawn_x();
+            player.posY = file.get_spawn_y();
+            previous_camera = player;
+            return true;
+        }
+
+        // Ambient light everywhere; it holds no cells, as all cells off a LightMap get the ambient level
+        static LightMap ambient_light_map() {
+            return LightMap(0, 0, Settings::AMBIENT_LIGHT);
+        }
+
+        // Lights of the streamed map while there is one, else of world
+        const LightMap& active_light_map() const {
+            return chunks ? streamed_light_map : light_map;
+        }
+
+        // Cells of the streamed map while there is one, else of world
+        bool cell_solid(int x, int y) const {
+            return chunks ? chunks->solid(x, y) : world.solid(x, y);
+        }
+
+        int cell_material(int x, int y) const {
+            return chunks ? chunks->material(x, y) : world.material(x, y);
+        }
+
+        static MapLayout settings_map_layout() {
+            MapLayout layout;
+            if (!parse_map_layout(Settings::MAP_LAYOUT, layout)) throw std::runtime_error("Unknown MAP_LAYOUT, use rowmajor, tiled or morton");
+            return layout;
+        }
+
+        // Mip chain of a wall type
+        const std::vector<GraphicsEngine::Texture>& wall_mips(int wallType) const {
+            return wall_textures[wall_index(wallType)];
+        }
+
+        // Everything on_draw needs from the simulation, copied once per frame by on_publish
+        struct FrameState {
+            Camera previous;
+            Camera current;
+            double alpha;
+            std::vector<Sprite> sprites;
+        };
+
+        // Map, read concurrently by on_update and the render threads. Only replaced between frames
+        // (set_map, set_chunk_source, load_map_file), while neither the simulation nor the render threads run.
+        WorldMap world;
+        DistanceField distance_field;  // Of world
+        std::unique_ptr<ChunkCache> chunks;  // Used instead of world while set; its chunks only change in on_publish
+
+        // Rendering
+        static const int COLUMN_BATCH = 64;
+        GraphicsEngine::SimdLevel ray_kernel = Raycaster::default_kernel();
+        bool fixed_point_dda = Settings::FIXED_POINT_DDA;
+        bool empty_space_skipping = Settings::EMPTY_SPACE_SKIPPING;
+        std::atomic<long long> cast_rays{ 0 };  // Rays and DDA steps of the frame being drawn, summed over the bands
+        std::atomic<long long> dda_steps{ 0 };
+        std::atomic<long long> total_cast_rays{ 0 };
+        bool textured_walls = Settings::TEXTURED_WALLS;
+
+        // Size of the generated textures
+        int texture_size = Settings::TEXTURE_SIZE;
+
+        // Mip chains of the wall textures, indexed by wall type - 1 and mip level
+        static const int WALL_TEXTURE_COUNT = 5;
+        GraphicsEngine::ShadeTable wall_shades;
+        std::vector<std::vector<GraphicsEngine::Texture>> wall_textures;
+        bool wall_mipmaps = Settings::WALL_MIPMAPS;
+
+        // Distance and light shading
+        bool distance_shading = Settings::DISTANCE_SHADING;
+        bool shade_dithering = Settings::SHADE_DITHERING;
+        GraphicsEngine::ColormapTable colormaps{ Settings::FOG_COLOR, Settings::FOG_DISTANCE };
+        LightMap light_map;  // Of world
+        const LightMap streamed_light_map = ambient_light_map();
+
+        // Floor and ceiling
+        bool floor_casting = Settings::FLOOR_CASTING;
+        GraphicsEngine::SimdLevel floor_kernel = FloorCaster::default_kernel();
+        GraphicsEngine::Texture floor_texture;
+        GraphicsEngine::Texture ceiling_texture;
+
+        // Sprites, and the wall distance of every screen column they are clipped against (sized for the full window)
+        std::vector<Sprite> sprites;
+        SpriteRenderer sprite_renderer;
+        std::vector<double> zbuffer = std::vector<double>(width);
+
+        // Ray directions of the columns for the frame being drawn
+        RayTable rays;
+
+        // Wall hits of the last frame and whether to reuse them
+        ColumnCache column_cache;
+        bool column_reuse = Settings::COLUMN_REUSE;
+
+        // What the last frame was drawn from, to skip frames that would come out the same
+        Camera drawn_camera{};
+        std::vector<Sprite> drawn_sprites;
+        bool redraw_requested = true;
+
+        // Player: start position, initial direction vector and the 2d raycaster version of camera plane
+        Camera player{ Settings::SPAWN_X, Settings::SPAWN_Y, -1, 0, 0, 0.66 };
+
+        // Cosine and sine of the last per tick turn angle
+        double turn_angle = 0, turn_cos = 1, turn_sin = 0;
+
+        // Player state before the last tick and the blend factor towards the current one
+        Camera previous_camera = get_camera();
+        double interpolation_alpha = 1.0;
+
+        // Player state the current frame is drawn from; written only by on_publish
+        FrameState render_state{ previous_camera, previous_camera, 1.0, {} };
     };
 }
 
@@ -3,9 +3,12 @@
 #include <iostream>
 #include <string>
 #include <cmath>
+#include <atomic>
+#include <bitset>
+#include <memory>
 
 #include <vector>
-#include <unordered_map>
+#include <algorithm>
 
 #include <random>
 
@@ -15,6 +18,13 @@
 #include <SDL2/SDL_mouse.h>
 #include <SDL2/SDL_timer.h>
 
+#include "Colormap.hpp"
+#include "Pixel.hpp"
+#include "Profiler.hpp"
+#include "ResolutionController.hpp"
+#include "Texture.hpp"
+#include "WorkerPool.hpp"
+
 
 namespace GraphicsEngine {
     class Timer {
@@ -38,59 +48,78 @@ namespace GraphicsEngine {
         Uint64 start;
     };
 
+    enum class KeyState {
+        NotObserved,
+        Pressed,
+        Released,
+        NoChange
+    };
+
+    /**
+     * Held state of SIZE keys or buttons in a flat bit table, plus the keys that went down
+     * and up since the last begin_frame. Codes outside [0, SIZE) are never held.
+     */
+    template <int SIZE>
     class StateManager {
     public:
-        enum class KeyState {
-            NotObserved,
-            Pressed,
-            Released,
-            NoChange
-        };
-
-        bool is_key_hold(int key_code) {
-            KeyState state = get_state(key_code);
-            if (state == KeyState::Pressed) {
-                return true;
-            }
-            return false;
+        bool is_key_hold(int key_code) const {
+            return in_range(key_code) && held[key_code];
         }
 
-        KeyState check_change(bool state, int key_code) {
-            KeyState last_key_state = get_state(key_code);
+        // Edges since the last begin_frame, so a tap shorter than a frame is still seen
+        bool was_pressed(int key_code) const {
+            return in_range(key_code) && pressed[key_code];
+        }
+
+        bool was_released(int key_code) const {
+            return in_range(key_code) && released[key_code];
+        }
 
-            KeyState current_key_state;
-            if (state) current_key_state = KeyState::Pressed;
-            else current_key_state = KeyState::Released;
+        // Clears the edges, called before the events of a frame are handled
+        void begin_frame() {
+            pressed.reset();
+            released.reset();
+        }
 
-            if (last_key_state == KeyState::NotObserved) last_key_state = KeyState::Released;
-            if (last_key_state == current_key_state) return KeyState::NoChange;  // Return the unchanged state
+        KeyState check_change(bool state, int key_code) {
+            if (!in_range(key_code) || held[key_code] == state) return KeyState::NoChange;
 
-            if (last_key_state == KeyState::Pressed && current_key_state == KeyState::Released) {
-                // Key got released
-                state_map[key_code] = KeyState::Released;
-                return KeyState::Released;
-            }
-            else if (last_key_state == KeyState::Released && current_key_state == KeyState::Pressed) {
+            held[key_code] = state;
+            if (state) {
                 // Key got pressed
-                state_map[key_code] = KeyState::Pressed;
+                pressed[key_code] = true;
                 return KeyState::Pressed;
             }
-            return KeyState::NoChange;  // Default return value
+            // Key got released
+            released[key_code] = true;
+            return KeyState::Released;
         }
 
-    private:
-        std::unordered_map<int, KeyState> state_map;
-
-        // Get the state of a key
-        KeyState get_state(int key) {
-            auto it = state_map.find(key);
-            if (it != state_map.end()) {
-                return it->second;
+        /**
+         * Replaces the held state with a snapshot like SDL_GetKeyboardState's, one byte per code.
+         * Keys whose state differs from the table count as pressed or released this frame.
+         */
+        void load_snapshot(const Uint8* state, int count) {
+            count = std::min(count, SIZE);
+            for (int i = 0; i < count; i++) {
+                check_change(state[i] != 0, i);
             }
-            return KeyState::NotObserved;
         }
+
+    private:
+        static bool in_range(int key_code) {
+            return (unsigned)key_code < (unsigned)SIZE;
+        }
+
+        std::bitset<SIZE> held;
+        std::bitset<SIZE> pressed;
+        std::bitset<SIZE> released;
     };
 
+    // Keys are tracked by SDL_Scancode, mouse buttons by their SDL_BUTTON_* index
+    typedef StateManager<SDL_NUM_SCANCODES> KeyboardState;
+    typedef StateManager<8> MouseButtonState;
+
     class Color {
     public:
         int red;    // Red component (0-255)
@@ -159,6 +188,11 @@ namespace GraphicsEngine {
             gamma = clamp(other.gamma, 0, 100);
         }
 
+        // The color in the framebuffer format; gamma is not part of it
+        Pixel to_pixel() const {
+            return make_pixel(Uint32(red), Uint32(green), Uint32(blue));
+        }
+
         // Divide operator overload
         Color operator/(int divisor) const {
             // Ensure that divisor is not zero to avoid division by zero
@@ -266,12 +300,143 @@ namespace GraphicsEngine {
     };
 
 
+    class FrameBuffer {
+    public:
+        // Pixels are stored as 0xAARRGGBB to match SDL_PIXELFORMAT_ARGB8888
+        static const Uint32 PIXEL_FORMAT = SDL_PIXELFORMAT_ARGB8888;
+
+        FrameBuffer(int width, int height)
+            : width(width), height(height), pixels(static_cast<size_t>(width) * height, 0xFF000000) {}
+
+        static Pixel pack(const Color& color) {
+            return color.to_pixel();
+        }
+
+        Pixel* data() {
+            return pixels.data();
+        }
+
+        const Pixel* data() const {
+            return pixels.data();
+        }
+
+        // Bytes per row, as expected by SDL_UpdateTexture
+        int pitch() const {
+            return width * static_cast<int>(sizeof(Pixel));
+        }
+
+        void clear(Pixel pixel) {
+            std::fill(pixels.begin(), pixels.end(), pixel);
+        }
+
+        // Changes the size; the pixels are undefined until the next clear. Shrinking keeps the memory.
+        void resize(int new_width, int new_height) {
+            width = new_width;
+            height = new_height;
+            pixels.resize(static_cast<size_t>(width) * height);
+        }
+
+        /**
+         * Fills the vertical span [y_start, y_end] of column x with a single pixel value.
+         * The span is clipped to the buffer, so callers may pass unclamped wall bounds.
+         */
+        void vline(int x, int y_start, int y_end, Pixel pixel) {
+            if (x < 0 || x >= width) return;
+            if (y_start < 0) y_start = 0;
+            if (y_end >= height) y_end = height - 1;
+
+            Pixel* p = pixels.data() + static_cast<size_t>(y_start) * width + x;
+            for (int y = y_start; y <= y_end; y++, p += width) {
+                *p = pixel;
+            }
+        }
+
+        /**
+         * Fills the vertical span [y_start, y_end] of column x from a texture column.
+         * The texture row is the integer part of the 16.16 tex_pos wrapped with row_mask, and tex_pos advances by tex_step
+         * per pixel, so there is no division in the loop. dim halves the brightness of the span.
+         */
+        void vline_textured(int x, int y_start, int y_end, const Pixel* column, int row_mask,
+                            Uint32 tex_pos, Uint32 tex_step, bool dim) {
+            if (x < 0 || x >= width) return;
+            if (y_start < 0) {
+                tex_pos += Uint32(-y_start) * tex_step;
+                y_start = 0;
+            }
+            if (y_end >= height) y_end = height - 1;
+
+            // Dimming is a shift and mask rather than a branch per pixel
+            const int shift = dim ? 1 : 0;
+            const Uint32 mask = dim ? 0x007F7F7Fu : 0x00FFFFFFu;
+
+            Pixel* p = pixels.data() + static_cast<size_t>(y_start) * width + x;
+            for (int y = y_start; y <= y_end; y++, p += width) {
+                Pixel texel = column[(tex_pos >> Texture::FRACTION_BITS) & row_mask];
+                *p = 0xFF000000u | ((texel >> shift) & mask);
+                tex_pos += tex_step;
+            }
+        }
+
+        // vline through the colormaps of shade
+        void vline_shaded(int x, int y_start, int y_end, Pixel pixel, const ShadeSpan& shade) {
+            if (x < 0 || x >= width) return;
+            if (y_start < 0) y_start = 0;
+            if (y_end >= height) y_end = height - 1;
+
+            // At most two colors, picked per pixel by the dither pattern
+            const Pixel nearer = shade.nearer->apply(pixel), farther = shade.farther->apply(pixel);
+            Pixel* p = pixels.data() + static_cast<size_t>(y_start) * width + x;
+            for (int y = y_start; y <= y_end; y++, p += width) {
+                *p = shade.fraction > ShadeSpan::DITHER[y & 3][x & 3] ? farther : nearer;
+            }
+        }
+
+        // vline_textured through the colormaps of shade
+        void vline_textured_shaded(int x, int y_start, int y_end, const Pixel* column, int row_mask,
+                                   Uint32 tex_pos, Uint32 tex_step, bool dim, const ShadeSpan& shade) {
+            if (x < 0 || x >= width) return;
+            if (y_start < 0) {
+                tex_pos += Uint32(-y_start) * tex_step;
+                y_start = 0;
+            }
+            if (y_end >= height) y_end = height - 1;
+
+            const int shift = dim ? 1 : 0;
+            const Uint32 mask = dim ? 0x007F7F7Fu : 0x00FFFFFFu;
+
+            Pixel* p = pixels.data() + static_cast<size_t>(y_start) * width + x;
+            for (int y = y_start; y <= y_end; y++, p += width) {
+                Pixel texel = column[(tex_pos >> Texture::FRACTION_BITS) & row_mask];
+                *p = shade.at(x, y).apply((texel >> shift) & mask);
+                tex_pos += tex_step;
+            }
+        }
+
+        int get_width() const {
+            return width;
+        }
+
+        int get_height() const {
+            return height;
+        }
+
+    private:
+        int width;
+        int height;
+        std::vector<Pixel> pixels;
+    };
+
+
     class Window {
     public:
         Draw* draw;
 
-        Window(int width, int height, std::string title)
-            : width(width), height(height), title(title), running(true) {
+        /**
+         * @param headless Render into the framebuffer only, without creating a window or renderer.
+         *                 Used by the benchmarks, which run on machines without a display.
+         */
+        Window(int width, int height, std::string title, bool headless = false)
+            : title(title), running(true), headless(headless), width(width), height(height), framebuffer(width, height) {
 
             if (!initSDL()) {
                 throw std::runtime_error("Failed to initialize SDL!");
@@ -281,9 +446,11 @@ namespace GraphicsEngine {
         }
 
         // Cleanup
-        ~Window() {
+        virtual ~Window() {
             delete draw;
-            SDL_DestroyWindow(window);
+            if (frame_texture) SDL_DestroyTexture(frame_texture);
+            if (renderer) SDL_DestroyRenderer(renderer);
+            if (window) SDL_DestroyWindow(window);
             SDL_Quit();
         }
 
@@ -298,7 +465,24 @@ namespace GraphicsEngine {
 
         // game loop
         virtual void on_draw(SDL_Renderer* renderer) {}
+        // Draw calls made here go on top of the uploaded framebuffer
+        virtual void on_draw_overlay(SDL_Renderer* renderer) {}
         virtual void on_update(double delta_time) {}
+        /**
+         * Called once per frame in fixed tick mode, after the ticks of that frame.
+         * @param alpha How far the frame lies between the last two ticks, in [0, 1).
+         */
+        virtual void on_interpolate(double alpha) {}
+        /**
+         * Copies the simulated state into the state on_draw reads. Called on the main thread before
+         * every frame is drawn, at a point where no on_update is running.
+         */
+        virtual void on_publish() {}
+        /**
+         * Whether on_draw would draw something different from the last frame. If not, nothing is
+         * drawn or presented, and the loop sleeps until an event arrives or the next tick is due.
+         */
+        virtual bool needs_redraw() { return true; }
 
         // key events
         virtual void on_key_press(SDL_Event e) {
@@ -317,24 +501,161 @@ namespace GraphicsEngine {
         }
         virtual void on_mouse_motion(SDL_Event e) {}
 
+        // Renders one frame outside of the game loop
+        void render_frame() {
+            Timer frameTimer;
+            on_publish();
+            if (draw_frame()) add_frame_time(frameTimer);
+            PROFILE_FRAME_END();
+        }
+
+        bool is_headless() const {
+            return headless;
+        }
+
+        const FrameBuffer& get_framebuffer() const {
+            return framebuffer;
+        }
+
         void run() {
             Timer gameTickTimer;
             double delta_time;
 
+#ifdef COOLGAME_PROFILE
+            PROFILE_THREAD_NAME("main");
+            if (const char* trace_path = SDL_getenv("COOLGAME_TRACE")) {
+                start_trace(trace_path);
+            }
+#endif
+
+            accumulator = 0.0;
             while (running) {
                 delta_time = gameTickTimer.get_elapsed_time();
                 gameTickTimer.reset();
+                bool presented;
+
+                {
+                    PROFILE_SCOPE("frame");
+                    Timer frameTimer;
+                    {
+                        PROFILE_SCOPE("handle_events");
+                        handle_events();
+                    }
+                    if (simulation) {
+                        // The next frame is simulated while this one is drawn from the published state.
+                        // Events and on_publish only run here, between wait() and run_async(), so the
+                        // simulation thread never sees input or state change under it.
+                        on_publish();
+                        simulation->run_async([this, delta_time]() { update(delta_time); });
+                        presented = draw_frame();
+                        simulation->wait();
+                    }
+                    else {
+                        update(delta_time);
+                        on_publish();
+                        presented = draw_frame();
+                    }
+                    if (presented) add_frame_time(frameTimer);
+                }
+                PROFILE_FRAME_END();
 
-                handle_events();
-                on_update(delta_time);
-                draw_frame();
+                if (presented) limit_frame_rate();
+                else wait_for_change();
+            }
+        }
 
-                SDL_Delay(0);  // Roughly 60 frames per second
+        /**
+         * Simulation ticks per second. With a tick rate on_update always gets the same delta,
+         * independent of the frame rate; 0 runs one variable length update per frame.
+         */
+        void set_tick_rate(int ticks_per_second) {
+            tick_rate = std::max(ticks_per_second, 0);
+        }
+
+        int get_tick_rate() const {
+            return tick_rate;
+        }
+
+        // Upper limit for frames per second, 0 for no limit. The loop sleeps instead of spinning.
+        void set_frame_rate_cap(int frames_per_second) {
+            frame_rate_cap = std::max(frames_per_second, 0);
+            next_frame_deadline = 0;
+        }
+
+        int get_frame_rate_cap() const {
+            return frame_rate_cap;
+        }
+
+        /**
+         * Frame time budget in milliseconds, e.g. 8.3 for 120 frames per second. Frames that take
+         * longer lower the render resolution in steps; the frame is scaled up to the window when
+         * presented. 0 always renders at the window size.
+         */
+        void set_frame_time_budget(double budget_ms) {
+            resolution.set_budget(std::max(budget_ms, 0.0));
+        }
+
+        double get_frame_time_budget() const {
+            return resolution.get_budget();
+        }
+
+        // Size of the frame on_draw renders, the window size or less
+        int get_render_width() const {
+            return framebuffer.get_width();
+        }
+
+        int get_render_height() const {
+            return framebuffer.get_height();
+        }
+
+        // Wait for the display refresh in SDL_RenderPresent
+        void set_vsync(bool enabled) {
+            vsync = enabled;
+            if (renderer) {
+                SDL_RenderSetVSync(renderer, enabled ? 1 : 0);
+            }
+        }
+
+        bool get_vsync() const {
+            return vsync;
+        }
+
+        /**
+         * Runs on_update for frame N + 1 on a separate thread while frame N is drawn and presented.
+         * Raises throughput when both take a while, at the cost of one frame of input latency.
+         * on_update and on_draw then run concurrently, so on_draw may only read what on_publish copied.
+         */
+        void set_pipelined(bool enabled) {
+            if (enabled && !simulation) {
+                simulation.reset(new BackgroundTask("simulation"));
             }
+            else if (!enabled) {
+                simulation.reset();
+            }
+        }
+
+        bool is_pipelined() const {
+            return simulation != nullptr;
+        }
+
+        /**
+         * Also reads the whole SDL_GetKeyboardState snapshot into key_manager every frame, so held
+         * keys stay right even when key events are missed, e.g. while the window had no focus.
+         */
+        void set_keyboard_polling(bool enabled) {
+            keyboard_polling = enabled;
+        }
+
+        bool get_keyboard_polling() const {
+            return keyboard_polling;
         }
 
     private:
         bool initSDL() {
+            if (headless) {
+                return true;
+            }
+
             window = SDL_CreateWindow(
                 title.c_str(),
                 SDL_WINDOWPOS_CENTERED,
@@ -356,30 +677,47 @@ namespace GraphicsEngine {
                 return false;
             }
 
+            // The whole scene is rendered on the CPU and uploaded once per frame
+            frame_texture = SDL_CreateTexture(renderer, FrameBuffer::PIXEL_FORMAT, SDL_TEXTUREACCESS_STREAMING, width, height);
+
+            if (!frame_texture) {
+                std::cout << "Frame texture creation failed: " << SDL_GetError() << std::endl;
+                return false;
+            }
+
             return true;
         }
 
         void handle_key_events(SDL_Event e) {
             // Quick exit for debugging and testing while developing window class
-            int key_code = e.key.keysym.sym;
-            const int ESCAPE_KEY = 27;
-            if (key_code == ESCAPE_KEY) {
+            int key_code = e.key.keysym.scancode;
+            if (key_code == SDL_SCANCODE_ESCAPE) {
                 exit_game();
                 return;  // Important to exit early.
             }
 
-            bool key_pressed;
-            if (e.type == SDL_KEYDOWN) {
-                key_pressed = true;
+#ifdef COOLGAME_PROFILE
+            // F3 toggles the profiler overlay, F4 starts and stops a trace
+            if (key_code == SDL_SCANCODE_F3 && e.type == SDL_KEYDOWN && !e.key.repeat) {
+                show_profile_overlay = !show_profile_overlay;
             }
-            else if (e.type == SDL_KEYUP) {
-                key_pressed = false;
+            if (key_code == SDL_SCANCODE_F4 && e.type == SDL_KEYDOWN && !e.key.repeat) {
+                if (Profiler::get().is_tracing()) {
+                    Profiler::get().stop_trace();
+                    std::cout << "Trace stopped" << std::endl;
+                }
+                else {
+                    start_trace("trace_" + std::to_string(SDL_GetTicks()) + ".json");
+                }
             }
-            StateManager::KeyState key_action = key_manager.check_change(key_pressed, key_code);
-            if (key_action == StateManager::KeyState::Pressed) {
+#endif
+
+            bool key_pressed = e.type == SDL_KEYDOWN;
+            KeyState key_action = key_manager.check_change(key_pressed, key_code);
+            if (key_action == KeyState::Pressed) {
                 on_key_press(e);
             }
-            else if (key_action == StateManager::KeyState::Released) {
+            else if (key_action == KeyState::Released) {
                 on_key_release(e);
             }
         }
@@ -390,24 +728,21 @@ namespace GraphicsEngine {
                 return;
             }
 
-            int button_code = e.button.button;;
-            bool mouse_pressed;
-            if (e.type == SDL_MOUSEBUTTONDOWN) {
-                mouse_pressed = true;
-            }
-            else if (e.type == SDL_MOUSEBUTTONUP) {
-                mouse_pressed = false;
-            }
-            StateManager::KeyState mouse_action = mouse_manager.check_change(mouse_pressed, button_code);
-            if (mouse_action == StateManager::KeyState::Pressed) {
+            int button_code = e.button.button;
+            bool mouse_pressed = e.type == SDL_MOUSEBUTTONDOWN;
+            KeyState mouse_action = mouse_manager.check_change(mouse_pressed, button_code);
+            if (mouse_action == KeyState::Pressed) {
                 on_mouse_press(e);
             }
-            else if (mouse_action == StateManager::KeyState::Released) {
+            else if (mouse_action == KeyState::Released) {
                 on_mouse_release(e);
             }
         }
 
         void handle_events() {
+            key_manager.begin_frame();
+            mouse_manager.begin_frame();
+
             SDL_Event e;
             while (SDL_PollEvent(&e) != 0) {
                 if (e.type == SDL_QUIT) {
@@ -421,17 +756,142 @@ namespace GraphicsEngine {
                     e.type == SDL_MOUSEMOTION) {
                     handle_mouse_events(e);
                 }
+                else if (e.type == SDL_WINDOWEVENT) {
+                    // Exposed, resized or restored windows may have lost the last frame
+                    present_requested = true;
+                }
+            }
+
+            if (keyboard_polling) {
+                // SDL updates the snapshot while pumping events, so it is read right after
+                int count = 0;
+                const Uint8* state = SDL_GetKeyboardState(&count);
+                key_manager.load_snapshot(state, count);
             }
         }
 
-        void draw_frame() {
-            // clear screen
-            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-            SDL_RenderClear(renderer);
+        // Returns whether a frame was presented
+        bool draw_frame() {
+            bool redraw = needs_redraw();
+#ifdef COOLGAME_PROFILE
+            redraw = redraw || show_profile_overlay;  // Its numbers change every frame
+#endif
+
+            // Render size picked from the frame times so far
+            int render_width = resolution.scaled(width), render_height = resolution.scaled(height);
+            if (render_width != framebuffer.get_width() || render_height != framebuffer.get_height()) {
+                framebuffer.resize(render_width, render_height);
+                redraw = true;
+            }
+
+            present_wait_ms = 0.0;
+            if (redraw) {
+                // clear screen
+                framebuffer.clear(0xFF000000);
 
-            on_draw(renderer);
+                {
+                    PROFILE_SCOPE("on_draw");
+                    on_draw(renderer);
+                }
+            }
 
-            SDL_RenderPresent(renderer);
+            if (headless) {
+                return redraw;
+            }
+            if (!redraw && !present_requested) {
+                return false;  // The last frame is still on screen
+            }
+            present_requested = false;
+
+#ifdef COOLGAME_PROFILE
+            if (show_profile_overlay) {
+                profile_overlay.draw(framebuffer.data(), framebuffer.get_width(), framebuffer.get_height());
+            }
+#endif
+
+            {
+                PROFILE_SCOPE("upload");
+                // Single upload of the CPU framebuffer per frame; an unchanged frame is still in the texture.
+                // A frame rendered below the window size goes to the top left corner and is stretched to the window.
+                SDL_Rect area{ 0, 0, framebuffer.get_width(), framebuffer.get_height() };
+                if (redraw) SDL_UpdateTexture(frame_texture, &area, framebuffer.data(), framebuffer.pitch());
+                SDL_RenderCopy(renderer, frame_texture, &area, nullptr);
+            }
+
+            on_draw_overlay(renderer);
+
+            {
+                PROFILE_SCOPE("SDL_RenderPresent");
+                Timer presentTimer;
+                SDL_RenderPresent(renderer);
+                if (vsync) present_wait_ms = presentTimer.get_elapsed_time() * 1000.0;
+            }
+            return true;
+        }
+
+        // Advances the simulation by one frame's worth of time
+        void update(double delta_time) {
+            PROFILE_SCOPE("on_update");
+            if (tick_rate > 0) {
+                // Simulate in fixed steps; the remainder is blended by on_interpolate
+                double tick = 1.0 / tick_rate;
+                accumulator += std::min(delta_time, MAX_FRAME_DELTA);
+                while (accumulator >= tick) {
+                    on_update(tick);
+                    accumulator -= tick;
+                }
+                on_interpolate(accumulator / tick);
+            }
+            else {
+                on_update(delta_time);
+            }
+        }
+
+#ifdef COOLGAME_PROFILE
+        void start_trace(const std::string& path) {
+            if (Profiler::get().start_trace(path)) {
+                std::cout << "Tracing to " << path << std::endl;
+            }
+            else {
+                std::cout << "Could not open trace file " << path << std::endl;
+            }
+        }
+#endif
+
+        /**
+         * Feeds the time of a presented frame, from events to present, to the resolution controller.
+         * With vsync the wait for the display refresh inside SDL_RenderPresent is left out, as it
+         * isn't work a smaller frame would save.
+         */
+        void add_frame_time(Timer& frameTimer) {
+            resolution.add_frame(std::max(frameTimer.get_elapsed_time() * 1000.0 - present_wait_ms, 0.0));
+        }
+
+        // Sleeps after a frame with nothing new to show until an event arrives or the next tick is due
+        void wait_for_change() {
+            if (headless) return;
+            double wait_ms = tick_rate > 0 ? (1.0 / tick_rate - accumulator) * 1000.0 : IDLE_WAIT_MS;
+            SDL_WaitEventTimeout(nullptr, std::max(1, (int)std::ceil(wait_ms)));
+        }
+
+        // Sleeps until the next frame is due when a frame rate cap is set
+        void limit_frame_rate() {
+            if (frame_rate_cap <= 0) return;
+
+            Uint64 now = SDL_GetPerformanceCounter();
+            Uint64 freq = SDL_GetPerformanceFrequency();
+            Uint64 frame_ticks = freq / frame_rate_cap;
+
+            // Deadlines advance by whole frames so sleep rounding doesn't add up; after a long
+            // hitch start over instead of rendering a burst of frames to catch up.
+            if (next_frame_deadline == 0 || now > next_frame_deadline + frame_ticks) {
+                next_frame_deadline = now;
+            }
+            next_frame_deadline += frame_ticks;
+
+            if (now < next_frame_deadline) {
+                SDL_Delay((Uint32)((next_frame_deadline - now) * 1000 / freq));
+            }
         }
 
         void set_running(bool value) {
@@ -444,17 +904,50 @@ namespace GraphicsEngine {
         std::string title;
         SDL_Window* window = nullptr;
         SDL_Renderer* renderer = nullptr;
+        SDL_Texture* frame_texture = nullptr;
 
         // game loop
-        bool running;
+        std::atomic<bool> running;  // Also cleared by on_update, which may run on the simulation thread
+        bool headless;
+        int tick_rate = 0;
+        double accumulator = 0.0;
+        int frame_rate_cap = 0;
+        bool vsync = false;
+        bool keyboard_polling = false;
+        Uint64 next_frame_deadline = 0;
+        bool present_requested = false;
+        double present_wait_ms = 0.0;  // Time the last SDL_RenderPresent took with vsync on
+
+        // Set in pipelined mode
+        std::unique_ptr<BackgroundTask> simulation;
+
+        // Render resolution from the frame time budget
+        ResolutionController resolution;
+
+        // Longest frame the fixed tick loop catches up on, so a hitch can't cause a spiral of updates
+        static constexpr double MAX_FRAME_DELTA = 0.25;
+
+        // Longest idle sleep without a tick rate, in milliseconds
+        static constexpr double IDLE_WAIT_MS = 10.0;
+
+#ifdef COOLGAME_PROFILE
+        ProfileOverlay profile_overlay;
+        bool show_profile_overlay = false;  // Redraws every frame while shown, F3 toggles it
+#endif
 
     protected:
         // window
         int width;
         int height;
 
+        // CPU side frame, filled by on_draw and uploaded in draw_frame
+        FrameBuffer framebuffer;
+
+        // Threads shared by the per-frame rendering work
+        WorkerPool workers;
+
         // evnet handling
-        StateManager key_manager;
-        StateManager mouse_manager;
+        KeyboardState key_manager;
+        MouseButtonState mouse_manager;
     };
 }
@@ -0,0 +1,63 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+
+#include "Colormap.hpp"
+
+
+namespace GameLogic {
+    /**
+     * Light level of every map cell, the grid version of Doom's sector light levels.
+     * Levels go from 0 (dark) to ColormapTable::MAX_LIGHT; cells outside the map get the
+     * ambient level.
+     */
+    class LightMap {
+    public:
+        LightMap()
+            : LightMap(0, 0, GraphicsEngine::ColormapTable::MAX_LIGHT) {}
+
+        LightMap(int map_width, int map_height, int ambient)
+            : map_width(map_width), map_height(map_height), ambient(clamp_level(ambient)),
+              levels((size_t)map_width * map_height, clamp_level(ambient)) {}
+
+        // Sets the cells [x0, x1] x [y0, y1] to level, clipped to the map
+        void fill(int x0, int y0, int x1, int y1, int level) {
+            for (int x = std::max(x0, 0); x <= std::min(x1, map_width - 1); x++) {
+                for (int y = std::max(y0, 0); y <= std::min(y1, map_height - 1); y++) {
+                    levels[(size_t)x * map_height + y] = clamp_level(level);
+                }
+            }
+        }
+
+        int level(int cellX, int cellY) const {
+            if ((unsigned)cellX >= (unsigned)map_width || (unsigned)cellY >= (unsigned)map_height) return ambient;
+            return levels[(size_t)cellX * map_height + cellY];
+        }
+
+        int get_map_width() const {
+            return map_width;
+        }
+
+        int get_map_height() const {
+            return map_height;
+        }
+
+        int get_ambient() const {
+            return ambient;
+        }
+
+        const int* data() const {
+            return levels.data();
+        }
+
+    private:
+        static int clamp_level(int level) {
+            return std::min(std::max(level, 0), GraphicsEngine::ColormapTable::MAX_LIGHT);
+        }
+
+        int map_width;
+        int map_height;
+        int ambient;
+        std::vector<int> levels;  // Indexed like the map, [x * map_height + y]; ints so vector code can gather them
+    };
+}
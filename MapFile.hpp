@@ -0,0 +1,329 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "DistanceField.hpp"
+#include "WorldMap.hpp"
+
+
+namespace GameLogic {
+    /**
+     * Read only mapping of a whole file. Pages are read from disk as they are first touched,
+     * so mapping a large file costs next to nothing until its data is used.
+     */
+    class MappedFile {
+    public:
+        // nullptr if the file can't be opened or mapped
+        static std::shared_ptr<const MappedFile> open(const std::string& path) {
+            std::shared_ptr<MappedFile> file(new MappedFile());
+#ifdef _WIN32
+            file->handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file->handle == INVALID_HANDLE_VALUE) return nullptr;
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(file->handle, &size) || size.QuadPart == 0) return nullptr;
+            file->length = (size_t)size.QuadPart;
+            file->mapping = CreateFileMappingA(file->handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!file->mapping) return nullptr;
+            file->bytes = static_cast<const uint8_t*>(MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return nullptr;
+            struct stat info;
+            if (fstat(fd, &info) != 0 || info.st_size == 0) {
+                close(fd);
+                return nullptr;
+            }
+            file->length = (size_t)info.st_size;
+            void* bytes = mmap(nullptr, file->length, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);  // The mapping stays valid
+            file->bytes = bytes == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(bytes);
+#endif
+            if (!file->bytes) return nullptr;
+            return file;
+        }
+
+        ~MappedFile() {
+#ifdef _WIN32
+            if (bytes) UnmapViewOfFile(bytes);
+            if (mapping) CloseHandle(mapping);
+            if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+#else
+            if (bytes) munmap(const_cast<uint8_t*>(bytes), length);
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const uint8_t* data() const {
+            return bytes;
+        }
+
+        size_t size() const {
+            return length;
+        }
+
+    private:
+        MappedFile() = default;
+
+        const uint8_t* bytes = nullptr;
+        size_t length = 0;
+#ifdef _WIN32
+        HANDLE handle = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#endif
+    };
+
+    // Grids a map file can hold; Solid and Materials are required
+    enum class MapLayer : uint32_t {
+        Solid = 1,      // WorldMap::bits(), word_count() little endian 64 bit words
+        Materials = 2,  // WorldMap::material_data(), a byte per cell
+        Distances = 3   // DistanceField::data(), a byte per cell
+    };
+
+    /**
+     * Start of a .cmap file. The header is followed by layer_count MapFileLayer entries at
+     * layer_table, which point at the grids. Grids are stored exactly as WorldMap and
+     * DistanceField keep them, in the map's layout and aligned to LAYER_ALIGNMENT, so a
+     * mapped file is used in place. Everything is little endian.
+     */
+    struct MapFileHeader {
+        char magic[4];         // "CMAP"
+        uint32_t version;      // MapFile::VERSION
+        uint32_t header_size;  // sizeof(MapFileHeader) of the writer's version
+        uint32_t width, height;
+        uint32_t layout;       // MapLayout
+        double spawnX, spawnY; // Where the player starts
+        uint64_t layer_table;
+        uint32_t layer_count;
+        uint32_t reserved;
+    };
+
+    struct MapFileLayer {
+        uint32_t type;  // MapLayer
+        uint32_t reserved;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    static_assert(sizeof(MapFileHeader) == 56 && sizeof(MapFileLayer) == 24, "Map file structs must not be padded");
+
+    /**
+     * A map loaded from a .cmap file (written by mapconv): the map and its distance field,
+     * both viewing the mapped file. Loading checks the header, the layer table and that every
+     * grid lies inside the file and has the size the map needs, and that the border cells are
+     * solid, so rays can't step off the map; the cells themselves aren't read, which keeps
+     * loading instant for any size. The distance layer is trusted: distances that are too large
+     * let rays jump over walls and hit the wrong ones. verify() checks the cells, distances
+     * included (mapconv --check).
+     */
+    class MapFile {
+    public:
+        static const uint32_t VERSION = 1;
+        static const size_t LAYER_ALIGNMENT = 64;
+
+        // Largest width and height, so cell indices fit in the DDA's ints and 64 bit lanes
+        static const int MAX_SIZE = 1 << 20;
+
+        /**
+         * Maps path into file. Returns false if it can't be opened, with error left empty, or
+         * isn't a valid map file, with error telling why.
+         */
+        static bool load(const std::string& path, MapFile& file, std::string& error) {
+            error.clear();
+            std::shared_ptr<const MappedFile> mapped = MappedFile::open(path);
+            if (!mapped) return false;
+
+            auto fail = [&](const std::string& reason) {
+                error = path + ": " + reason;
+                return false;
+            };
+            if (!is_little_endian()) return fail("map files are little endian");
+
+            const uint8_t* data = mapped->data();
+            const size_t size = mapped->size();
+            MapFileHeader header;
+            if (size < sizeof(header)) return fail("too small for a map file");
+            std::memcpy(&header, data, sizeof(header));
+            if (std::memcmp(header.magic, "CMAP", 4) != 0) return fail("not a map file");
+            if (header.version != VERSION) return fail("version " + std::to_string(header.version) + ", expected " + std::to_string(VERSION));
+            if (header.header_size != sizeof(header)) return fail("bad header size");
+            if (header.width < 3 || header.height < 3 || header.width > MAX_SIZE || header.height > MAX_SIZE) {
+                return fail("map size must be 3 to " + std::to_string(MAX_SIZE) + " cells");
+            }
+            if (header.layout > (uint32_t)MapLayout::Morton) return fail("unknown layout");
+            if (!(header.spawnX >= 1 && header.spawnX < header.width - 1 && header.spawnY >= 1 && header.spawnY < header.height - 1)) {
+                return fail("spawn point off the map");
+            }
+            if (header.layer_table > size || header.layer_count > (size - header.layer_table) / sizeof(MapFileLayer)) {
+                return fail("layer table out of the file");
+            }
+
+            const size_t cells = layout_cells(header.width, header.height, (MapLayout)header.layout);
+            const uint8_t* layers[4] = {};
+            for (uint32_t i = 0; i < header.layer_count; i++) {
+                MapFileLayer layer;
+                std::memcpy(&layer, data + header.layer_table + i * sizeof(layer), sizeof(layer));
+                if (layer.type < (uint32_t)MapLayer::Solid || layer.type > (uint32_t)MapLayer::Distances) continue;  // Unknown layers are skipped, so writers can add some
+                if (layers[layer.type]) return fail("layer " + std::to_string(layer.type) + " appears twice");
+                if (layer.offset % LAYER_ALIGNMENT != 0) return fail("layer " + std::to_string(layer.type) + " is not aligned");
+                if (layer.offset > size || layer.size > size - layer.offset) return fail("layer " + std::to_string(layer.type) + " out of the file");
+                size_t expected = layer.type == (uint32_t)MapLayer::Solid ? (cells + 63) / 64 * sizeof(uint64_t) : cells;
+                if (layer.size != expected) return fail("layer " + std::to_string(layer.type) + " has the wrong size");
+                layers[layer.type] = data + layer.offset;
+            }
+            if (!layers[(int)MapLayer::Solid] || !layers[(int)MapLayer::Materials]) return fail("solid or material layer missing");
+
+            // Built aside, so file is only replaced by a valid map
+            MapFile loaded;
+            loaded.header = header;
+            loaded.map = WorldMap((int)header.width, (int)header.height, (MapLayout)header.layout,
+                                reinterpret_cast<const uint64_t*>(layers[(int)MapLayer::Solid]), layers[(int)MapLayer::Materials], mapped);
+            const WorldMap& map = loaded.map;
+            if (!map.has_solid_border()) return fail("border cells must be solid");
+
+            if (map.solid((int)header.spawnX, (int)header.spawnY)) return fail("spawn point inside a wall");
+
+            // Writers may leave the distances out, they are computed then
+            loaded.precomputed = layers[(int)MapLayer::Distances] != nullptr;
+            loaded.distances = loaded.precomputed ? DistanceField(layers[(int)MapLayer::Distances], mapped) : DistanceField(map);
+            file = std::move(loaded);
+            return true;
+        }
+
+        /**
+         * Writes map with its distance field, the player starting at (spawnX, spawnY). Throws
+         * std::runtime_error if the file can't be written or the map can't be loaded again.
+         */
+        static void save(const std::string& path, const WorldMap& map, const DistanceField& distances, double spawnX, double spawnY) {
+            if (map.get_width() < 3 || map.get_height() < 3 || map.get_width() > MAX_SIZE || map.get_height() > MAX_SIZE) {
+                throw std::runtime_error("Map size must be 3 to " + std::to_string(MAX_SIZE) + " cells");
+            }
+
+            MapFileHeader header = {};
+            std::memcpy(header.magic, "CMAP", 4);
+            header.version = VERSION;
+            header.header_size = sizeof(header);
+            header.width = (uint32_t)map.get_width();
+            header.height = (uint32_t)map.get_height();
+            header.layout = (uint32_t)map.get_layout();
+            header.spawnX = spawnX;
+            header.spawnY = spawnY;
+            header.layer_table = sizeof(header);
+            header.layer_count = 3;
+
+            const size_t cells = map.cell_count();
+            const void* grids[3] = { map.bits(), map.material_data(), distances.data() };
+            MapFileLayer layers[3] = {
+                { (uint32_t)MapLayer::Solid, 0, 0, map.word_count() * sizeof(uint64_t) },
+                { (uint32_t)MapLayer::Materials, 0, 0, cells },
+                { (uint32_t)MapLayer::Distances, 0, 0, cells }
+            };
+            uint64_t offset = header.layer_table + sizeof(layers);
+            for (MapFileLayer& layer : layers) {
+                offset = (offset + LAYER_ALIGNMENT - 1) / LAYER_ALIGNMENT * LAYER_ALIGNMENT;
+                layer.offset = offset;
+                offset += layer.size;
+            }
+
+            std::FILE* out = std::fopen(path.c_str(), "wb");
+            if (!out) throw std::runtime_error("Can't write " + path);
+            bool written = std::fwrite(&header, sizeof(header), 1, out) == 1 && std::fwrite(layers, sizeof(layers), 1, out) == 1;
+            uint64_t position = header.layer_table + sizeof(layers);
+            const char padding[LAYER_ALIGNMENT] = {};
+            for (int i = 0; i < 3 && written; i++) {
+                written = std::fwrite(padding, 1, (size_t)(layers[i].offset - position), out) == layers[i].offset - position &&
+                          std::fwrite(grids[i], 1, (size_t)layers[i].size, out) == layers[i].size;
+                position = layers[i].offset + layers[i].size;
+            }
+            written = std::fclose(out) == 0 && written;
+            if (!written) throw std::runtime_error("Can't write " + path);
+        }
+
+        /**
+         * Reads every cell: materials have to match the solid bits and the distances the ones
+         * DistanceField computes. Takes as long as the map is large; for tools, not for loading.
+         */
+        bool verify(std::string& error) const {
+            for (int x = 0; x < map.get_width(); x++) {
+                for (int y = 0; y < map.get_height(); y++) {
+                    if (map.solid(x, y) != (map.material(x, y) != 0)) {
+                        error = "cell " + std::to_string(x) + ", " + std::to_string(y) + " has a material but isn't solid, or the other way round";
+                        return false;
+                    }
+                }
+            }
+            if (precomputed) {
+                const DistanceField expected(map);
+                const size_t cells = map.cell_count();
+                if (std::memcmp(expected.data(), distances.data(), cells) != 0) {
+                    error = "distance layer doesn't match the map";
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        const WorldMap& get_map() const {
+            return map;
+        }
+
+        const DistanceField& get_distances() const {
+            return distances;
+        }
+
+        // Whether the distances came from the file rather than being computed on load
+        bool has_precomputed_distances() const {
+            return precomputed;
+        }
+
+        double get_spawn_x() const {
+            return header.spawnX;
+        }
+
+        double get_spawn_y() const {
+            return header.spawnY;
+        }
+
+    private:
+        static bool is_little_endian() {
+            const uint16_t probe = 1;
+            uint8_t first;
+            std::memcpy(&first, &probe, 1);
+            return first == 1;
+        }
+
+        static size_t layout_cells(int width, int height, MapLayout layout) {
+            switch (layout) {
+            case MapLayout::Tiled:  return TiledLayout(width, height).size();
+            case MapLayout::Morton: return MortonLayout(width, height).size();
+            default:                return RowMajorLayout(width, height).size();
+            }
+        }
+
+        MapFileHeader header = {};
+        WorldMap map;
+        DistanceField distances;
+        bool precomputed = false;
+    };
+}
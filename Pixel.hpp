@@ -0,0 +1,74 @@
+#pragma once
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+
+namespace GraphicsEngine {
+    /**
+     * A pixel in the renderer's native format, SDL_PIXELFORMAT_ARGB8888: 0xAARRGGBB in one
+     * 32-bit word. The per pixel code works on these; Color is for convenience code.
+     */
+    typedef Uint32 Pixel;
+
+    // Opaque pixel from 8-bit channels
+    inline Pixel make_pixel(Uint32 red, Uint32 green, Uint32 blue) {
+        return 0xFF000000u | (red << 16) | (green << 8) | blue;
+    }
+
+    inline Uint32 pixel_red(Pixel pixel) {
+        return (pixel >> 16) & 0xFF;
+    }
+
+    inline Uint32 pixel_green(Pixel pixel) {
+        return (pixel >> 8) & 0xFF;
+    }
+
+    inline Uint32 pixel_blue(Pixel pixel) {
+        return pixel & 0xFF;
+    }
+
+    /**
+     * Shades of a few base colors, indexed by color, side and brightness, so the renderer fills
+     * spans with a lookup instead of computing colors. Side 1 is half as bright, like the y sides
+     * of walls; brightness MAX_BRIGHTNESS is the base color itself.
+     */
+    class ShadeTable {
+    public:
+        static const int SIDES = 2;
+        static const int BRIGHTNESS_LEVELS = 64;
+        static const int MAX_BRIGHTNESS = BRIGHTNESS_LEVELS - 1;
+
+        ShadeTable() = default;
+
+        explicit ShadeTable(const std::vector<Pixel>& base_colors)
+            : count((int)base_colors.size()), shades(base_colors.size() * SIDES * BRIGHTNESS_LEVELS) {
+            for (int color = 0; color < count; color++) {
+                for (int side = 0; side < SIDES; side++) {
+                    for (int brightness = 0; brightness < BRIGHTNESS_LEVELS; brightness++) {
+                        // Scaled first and halved second, as Color did it: exact at full brightness
+                        auto shade = [&](Uint32 channel) { return channel * brightness / MAX_BRIGHTNESS / (side + 1); };
+                        Pixel base = base_colors[color];
+                        shades[index(color, side, brightness)] = make_pixel(shade(pixel_red(base)), shade(pixel_green(base)), shade(pixel_blue(base)));
+                    }
+                }
+            }
+        }
+
+        Pixel get(int color, int side, int brightness) const {
+            return shades[index(color, side, brightness)];
+        }
+
+        int color_count() const {
+            return count;
+        }
+
+    private:
+        static size_t index(int color, int side, int brightness) {
+            return ((size_t)color * SIDES + side) * BRIGHTNESS_LEVELS + brightness;
+        }
+
+        int count = 0;
+        std::vector<Pixel> shades;
+    };
+}
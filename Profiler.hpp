@@ -0,0 +1,475 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SDL2/SDL_timer.h>
+
+#include "Font.hpp"
+
+/*
+Scoped hot-path profiling.
+
+    PROFILE_SCOPE("raycast");
+
+times the rest of the enclosing block and records it as one event of the "raycast" zone.
+Events from any thread go into a lock-free ring buffer that the main thread drains once per
+frame (PROFILE_FRAME_END), keeping a rolling history per zone for the stats overlay.
+
+While a trace is running (Profiler::start_trace, F4 in game or the COOLGAME_TRACE environment
+variable) the drained events are also written to a Chrome trace-event JSON file with one lane
+per thread, for finding the single frames that averages hide.
+
+Everything is compiled out unless COOLGAME_PROFILE is defined, so the macros can stay in
+release builds.
+*/
+
+#define COOLGAME_CONCAT_INNER(a, b) a##b
+#define COOLGAME_CONCAT(a, b) COOLGAME_CONCAT_INNER(a, b)
+
+#ifdef COOLGAME_PROFILE
+#define PROFILE_SCOPE(name) \
+    static const int COOLGAME_CONCAT(profile_zone_, __LINE__) = GraphicsEngine::Profiler::get().register_zone(name); \
+    GraphicsEngine::ProfileScope COOLGAME_CONCAT(profile_scope_, __LINE__)(COOLGAME_CONCAT(profile_zone_, __LINE__))
+#define PROFILE_FRAME_END() GraphicsEngine::Profiler::get().end_frame()
+#define PROFILE_THREAD_NAME(name) GraphicsEngine::Profiler::get().set_thread_name(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FRAME_END() ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#endif
+
+
+namespace GraphicsEngine {
+    struct ProfileEvent {
+        int zone;
+        int thread;
+        Uint64 start;
+        Uint64 end;
+    };
+
+    /**
+     * Bounded multi-producer, single-consumer ring of profile events.
+     * Producers never block: when the consumer falls behind, new events are dropped and counted.
+     */
+    class ProfileRing {
+    public:
+        static const size_t CAPACITY = 1 << 16;  // Must be a power of two
+
+        ProfileRing() : slots(CAPACITY) {
+            for (size_t i = 0; i < CAPACITY; i++) {
+                slots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        // Safe to call from any thread
+        bool push(const ProfileEvent& event) {
+            size_t pos = head.load(std::memory_order_relaxed);
+            while (true) {
+                Slot& slot = slots[pos & (CAPACITY - 1)];
+                size_t sequence = slot.sequence.load(std::memory_order_acquire);
+                long long diff = (long long)sequence - (long long)pos;
+                if (diff == 0) {
+                    // The slot is free for this position; claim it
+                    if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        slot.event = event;
+                        slot.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0) {
+                    // Full
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                else {
+                    pos = head.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Only the consumer thread may call this
+        bool pop(ProfileEvent& event) {
+            Slot& slot = slots[tail & (CAPACITY - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != tail + 1) return false;
+
+            event = slot.event;
+            slot.sequence.store(tail + CAPACITY, std::memory_order_release);
+            tail++;
+            return true;
+        }
+
+        size_t take_dropped() {
+            return dropped.exchange(0, std::memory_order_relaxed);
+        }
+
+    private:
+        struct Slot {
+            std::atomic<size_t> sequence;
+            ProfileEvent event;
+        };
+
+        std::vector<Slot> slots;
+        alignas(64) std::atomic<size_t> head{ 0 };
+        alignas(64) size_t tail = 0;
+        std::atomic<size_t> dropped{ 0 };
+    };
+
+    /**
+     * Writes profile events to a Chrome trace-event JSON file (chrome://tracing, ui.perfetto.dev).
+     * Formatting and file IO happen on a background thread; the frame only hands over a batch
+     * of raw events, so tracing barely shows up in the frames it records.
+     */
+    class TraceWriter {
+    public:
+        // Events of one or more frames plus the names needed to label them
+        struct Batch {
+            std::vector<ProfileEvent> events;
+            std::vector<std::string> zone_names;    // Full table when it changed, otherwise empty
+            std::vector<std::string> thread_names;  // Full table when it changed, otherwise empty
+        };
+
+        ~TraceWriter() {
+            close();
+        }
+
+        bool open(const std::string& path, Uint64 start_ticks) {
+            close();
+
+            file = std::fopen(path.c_str(), "wb");
+            if (!file) return false;
+            std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+            std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+
+            origin_ticks = start_ticks;
+            us_per_tick = 1e6 / SDL_GetPerformanceFrequency();
+            first_event = true;
+            zone_names.clear();
+            thread_names.clear();
+            stopping = false;
+            thread = std::thread([this]() { write_loop(); });
+            return true;
+        }
+
+        bool is_open() const {
+            return file != nullptr;
+        }
+
+        void submit(Batch&& batch) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queue.push_back(std::move(batch));
+            }
+            queue_ready.notify_one();
+        }
+
+        // Writes everything still queued and finishes the file
+        void close() {
+            if (!file) return;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            queue_ready.notify_one();
+            thread.join();
+
+            std::fputs("\n]}\n", file);
+            std::fclose(file);
+            file = nullptr;
+        }
+
+    private:
+        void write_loop() {
+            std::vector<Batch> batches;
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    queue_ready.wait(lock, [this]() { return stopping || !queue.empty(); });
+                    batches.swap(queue);
+                    if (batches.empty() && stopping) return;
+                }
+                for (Batch& batch : batches) {
+                    write_batch(batch);
+                }
+                batches.clear();
+            }
+        }
+
+        void write_batch(const Batch& batch) {
+            if (!batch.zone_names.empty()) zone_names = batch.zone_names;
+
+            // One lane per thread, named by a metadata event the first time the thread shows up
+            for (size_t id = thread_names.size(); id < batch.thread_names.size(); id++) {
+                begin_event();
+                std::fprintf(file, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                             (int)id, batch.thread_names[id].c_str());
+            }
+            if (batch.thread_names.size() > thread_names.size()) thread_names = batch.thread_names;
+
+            for (const ProfileEvent& event : batch.events) {
+                if (event.start < origin_ticks) continue;  // Recorded before the trace started
+
+                const char* name = event.zone < (int)zone_names.size() ? zone_names[event.zone].c_str() : "?";
+                begin_event();
+                std::fprintf(file, "{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                             name, event.thread, (event.start - origin_ticks) * us_per_tick, (event.end - event.start) * us_per_tick);
+            }
+        }
+
+        void begin_event() {
+            if (!first_event) std::fputs(",\n", file);
+            first_event = false;
+        }
+
+        std::FILE* file = nullptr;
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable queue_ready;
+        std::vector<Batch> queue;
+        bool stopping = false;
+
+        // Only touched by the writer thread while the file is open
+        Uint64 origin_ticks = 0;
+        double us_per_tick = 0.0;
+        bool first_event = true;
+        std::vector<std::string> zone_names;
+        std::vector<std::string> thread_names;
+    };
+
+    /**
+     * Process wide profiler: zone registry, event ring and per-zone frame history.
+     */
+    class Profiler {
+    public:
+        // Frames kept for the rolling statistics
+        static const int HISTORY_FRAMES = 240;
+
+        struct ZoneStats {
+            std::string name;
+            double average_ms;
+            double p50_ms;
+            double p99_ms;
+            double max_ms;
+        };
+
+        static Profiler& get() {
+            static Profiler profiler;
+            return profiler;
+        }
+
+        // Returns the id of a zone, registering it on first use
+        int register_zone(const char* name) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < zones.size(); i++) {
+                if (zones[i].name == name) return (int)i;
+            }
+            zones.push_back(Zone{ name, std::vector<double>(HISTORY_FRAMES, 0.0), 0.0 });
+            zones_changed = true;
+            return (int)zones.size() - 1;
+        }
+
+        // Small stable id of the calling thread, in order of first use
+        int thread_id() {
+            static std::atomic<int> next_id{ 0 };
+            thread_local int id = next_id.fetch_add(1);
+            return id;
+        }
+
+        // Names the calling thread's lane in traces
+        void set_thread_name(const std::string& name) {
+            int id = thread_id();
+            std::lock_guard<std::mutex> lock(mutex);
+            name_thread(id);
+            thread_names[id] = name;
+            threads_changed = true;
+        }
+
+        /**
+         * Starts writing every recorded event to a Chrome trace JSON file.
+         * @param frame_count Frames to record before the trace stops by itself, 0 to record until stop_trace().
+         */
+        bool start_trace(const std::string& path, int frame_count = 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!trace.open(path, SDL_GetPerformanceCounter())) return false;
+
+            // The writer starts without names
+            zones_changed = true;
+            threads_changed = true;
+            trace_frames_left = frame_count > 0 ? frame_count : -1;
+            return true;
+        }
+
+        void stop_trace() {
+            std::lock_guard<std::mutex> lock(mutex);
+            trace.close();
+        }
+
+        bool is_tracing() const {
+            return trace.is_open();
+        }
+
+        void record(int zone, Uint64 start, Uint64 end) {
+            ring.push(ProfileEvent{ zone, thread_id(), start, end });
+        }
+
+        /**
+         * Drains the events recorded since the last call and closes the frame: every zone's
+         * summed time for the frame goes into its history. Call from the main thread only.
+         */
+        void end_frame() {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            double ms_per_tick = 1000.0 / SDL_GetPerformanceFrequency();
+            TraceWriter::Batch batch;
+            ProfileEvent event;
+            while (ring.pop(event)) {
+                zones[event.zone].frame_ms += (event.end - event.start) * ms_per_tick;
+                name_thread(event.thread);
+                if (trace.is_open()) batch.events.push_back(event);
+            }
+            dropped_events += ring.take_dropped();
+
+            if (trace.is_open()) {
+                if (zones_changed) {
+                    for (const Zone& zone : zones) batch.zone_names.push_back(zone.name);
+                }
+                if (threads_changed) batch.thread_names = thread_names;
+                zones_changed = threads_changed = false;
+                trace.submit(std::move(batch));
+
+                if (trace_frames_left > 0 && --trace_frames_left == 0) trace.close();
+            }
+
+            for (Zone& zone : zones) {
+                zone.history[history_pos] = zone.frame_ms;
+                zone.frame_ms = 0.0;
+            }
+            history_pos = (history_pos + 1) % HISTORY_FRAMES;
+            if (history_frames < HISTORY_FRAMES) history_frames++;
+        }
+
+        // Rolling statistics of every zone over the last HISTORY_FRAMES frames
+        std::vector<ZoneStats> get_stats() {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            std::vector<ZoneStats> stats;
+            std::vector<double> samples;
+            for (const Zone& zone : zones) {
+                samples.clear();
+                for (int i = 0; i < history_frames; i++) {
+                    samples.push_back(zone.history[(history_pos - 1 - i + HISTORY_FRAMES) % HISTORY_FRAMES]);
+                }
+                if (samples.empty()) samples.push_back(0.0);
+                std::sort(samples.begin(), samples.end());
+
+                double sum = 0.0;
+                for (double ms : samples) sum += ms;
+                auto percentile = [&](double p) {
+                    return samples[std::min(samples.size() - 1, (size_t)(p * samples.size()))];
+                };
+                stats.push_back(ZoneStats{ zone.name, sum / samples.size(), percentile(0.50), percentile(0.99), samples.back() });
+            }
+            return stats;
+        }
+
+        size_t get_dropped_events() const {
+            return dropped_events;
+        }
+
+    private:
+        Profiler() = default;
+
+        // Gives threads that never called set_thread_name a default lane name
+        void name_thread(int id) {
+            while ((int)thread_names.size() <= id) {
+                thread_names.push_back("thread " + std::to_string(thread_names.size()));
+                threads_changed = true;
+            }
+        }
+
+        struct Zone {
+            std::string name;
+            std::vector<double> history;  // Summed milliseconds per frame
+            double frame_ms;              // Accumulator of the current frame
+        };
+
+        std::mutex mutex;
+        std::vector<Zone> zones;
+        std::vector<std::string> thread_names;
+        ProfileRing ring;
+        TraceWriter trace;
+        int trace_frames_left = 0;
+        bool zones_changed = false;
+        bool threads_changed = false;
+        int history_pos = 0;
+        int history_frames = 0;
+        size_t dropped_events = 0;
+    };
+
+    // Records the time between construction and destruction as one event of a zone
+    class ProfileScope {
+    public:
+        explicit ProfileScope(int zone) : zone(zone), start(SDL_GetPerformanceCounter()) {}
+
+        ~ProfileScope() {
+            Profiler::get().record(zone, start, SDL_GetPerformanceCounter());
+        }
+
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+
+    private:
+        int zone;
+        Uint64 start;
+    };
+
+    // Draws the rolling zone statistics as a text table in the top left corner of a frame
+    class ProfileOverlay {
+    public:
+        static const int SCALE = 2;
+
+        // Statistics are refreshed a few times per second so the numbers stay readable
+        void draw(Uint32* pixels, int width, int height) {
+            if (refresh_countdown-- <= 0) {
+                stats = Profiler::get().get_stats();
+                refresh_countdown = REFRESH_FRAMES;
+            }
+
+            std::vector<std::string> lines;
+            lines.push_back("ZONE              AVG    P50    P99    MAX MS");
+            char line[128];
+            for (const Profiler::ZoneStats& zone : stats) {
+                std::snprintf(line, sizeof(line), "%-14.14s %6.2f %6.2f %6.2f %6.2f",
+                              zone.name.c_str(), zone.average_ms, zone.p50_ms, zone.p99_ms, zone.max_ms);
+                lines.push_back(line);
+            }
+            size_t dropped = Profiler::get().get_dropped_events();
+            if (dropped > 0) {
+                lines.push_back("DROPPED EVENTS: " + std::to_string(dropped));
+            }
+
+            const int margin = 4;
+            size_t columns = 0;
+            for (const std::string& text : lines) columns = std::max(columns, text.size());
+            DebugFont::darken_rect(pixels, width, height, 0, 0,
+                                   (int)columns * DebugFont::advance(SCALE) + 2 * margin,
+                                   (int)lines.size() * DebugFont::line_height(SCALE) + 2 * margin);
+
+            for (size_t i = 0; i < lines.size(); i++) {
+                DebugFont::draw_text(pixels, width, height, margin, margin + (int)i * DebugFont::line_height(SCALE),
+                                     lines[i], i == 0 ? 0xFFFFFF00 : 0xFFFFFFFF, SCALE);
+            }
+        }
+
+    private:
+        static const int REFRESH_FRAMES = 15;
+
+        std::vector<Profiler::ZoneStats> stats;
+        int refresh_countdown = 0;
+    };
+}
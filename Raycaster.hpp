@@ -0,0 +1,631 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "ChunkedWorld.hpp"
+#include "DistanceField.hpp"
+#include "Simd.hpp"
+#include "WorldMap.hpp"
+
+
+namespace GameLogic {
+    // Camera state the raycaster needs for one frame
+    struct Camera {
+        double posX, posY;
+        double dirX, dirY;
+        double planeX, planeY;
+
+        /**
+         * Turns the view by an angle given as its cosine and sine. Direction and plane are the
+         * columns of the camera's rotation matrix, so both are rotated.
+         */
+        void rotate(double cosAngle, double sinAngle) {
+            double oldDirX = dirX;
+            dirX = dirX * cosAngle - dirY * sinAngle;
+            dirY = oldDirX * sinAngle + dirY * cosAngle;
+            double oldPlaneX = planeX;
+            planeX = planeX * cosAngle - planeY * sinAngle;
+            planeY = oldPlaneX * sinAngle + planeY * cosAngle;
+        }
+    };
+
+    // Result of one DDA ray
+    struct RayHit {
+        int mapX, mapY;
+        int side;   // 0 if an x side was hit, 1 for a y side
+        int steps;  // DDA steps the ray took; a jump over empty space counts as one
+        double perpWallDist;
+    };
+
+    // DDA state of a single ray
+    struct RayState {
+        double sideDistX, sideDistY;
+        double deltaDistX, deltaDistY;
+        int mapX, mapY;
+        int stepX, stepY;
+    };
+
+    // DDA state of a single ray in fixed point, with Raycaster::FIXED_FRACTION_BITS fraction bits
+    struct FixedRayState {
+        int64_t sideDistX, sideDistY;
+        int64_t deltaDistX, deltaDistY;
+        int mapX, mapY;
+        int stepX, stepY;
+    };
+
+    /**
+     * Per column ray setup of one frame, as contiguous arrays indexed by screen column.
+     * The camera space offset of a column only depends on the screen width, so those are kept
+     * until the width changes. Directions and DDA deltas are refreshed from the camera once per
+     * frame by plain loops that the compiler vectorizes; they use the same multiplies and adds
+     * the per column setup did, so hits don't change.
+     */
+    class RayTable {
+    public:
+        void update(const Camera& camera, int screen_width) {
+            if ((int)cameraX.size() != screen_width) resize(screen_width);
+
+            // Copied to locals so the stores below can't be assumed to change them
+            const double dirX = camera.dirX, dirY = camera.dirY;
+            const double planeX = camera.planeX, planeY = camera.planeY;
+            const double* offset = cameraX.data();
+            double* dx = rayDirX.data();
+            double* dy = rayDirY.data();
+            for (int x = 0; x < screen_width; x++) {
+                dx[x] = dirX + planeX * offset[x];
+                dy[x] = dirY + planeY * offset[x];
+            }
+
+            double* deltaX = deltaDistX.data();
+            double* deltaY = deltaDistY.data();
+            for (int x = 0; x < screen_width; x++) {
+                deltaX[x] = std::abs(1 / dx[x]);
+                deltaY[x] = std::abs(1 / dy[x]);
+            }
+        }
+
+        int get_width() const {
+            return (int)cameraX.size();
+        }
+
+        // Direction of the ray through each screen column
+        const double* ray_dir_x() const {
+            return rayDirX.data();
+        }
+
+        const double* ray_dir_y() const {
+            return rayDirY.data();
+        }
+
+        // Ray length between two x (or y) grid lines of each column
+        const double* delta_dist_x() const {
+            return deltaDistX.data();
+        }
+
+        const double* delta_dist_y() const {
+            return deltaDistY.data();
+        }
+
+    private:
+        void resize(int screen_width) {
+            cameraX.resize(screen_width);
+            for (int x = 0; x < screen_width; x++) {
+                cameraX[x] = 2 * x / (double)screen_width - 1;
+            }
+            rayDirX.resize(screen_width);
+            rayDirY.resize(screen_width);
+            deltaDistX.resize(screen_width);
+            deltaDistY.resize(screen_width);
+        }
+
+        std::vector<double> cameraX;  // -1 at the left screen edge to 1 at the right one
+        std::vector<double> rayDirX, rayDirY;
+        std::vector<double> deltaDistX, deltaDistY;
+    };
+
+    /**
+     * Grid DDA over a row of screen columns.
+     * The packet kernels step several adjacent rays together and give exactly the same
+     * hit cell, side and distance as the scalar loop: they use the same double precision
+     * adds and compares, only spread over vector lanes.
+     *
+     * With a DistanceField the scalar loop skips empty space: where the ray's cell is far
+     * from any wall it jumps over the open square around it in one step. The jump multiplies
+     * instead of adding once per cell, so double distances can differ from plain stepping in
+     * the last bits; fixed point ones can't.
+     *
+     * The loops are instantiated per map layout (WorldMap::with_layout), once per call, so
+     * stepping indexes the map without branching on its layout.
+     *
+     * On a streamed map (ChunkCache) rays look up the chunk they are in each time they cross
+     * into another one, on the scalar loop. A chunk that isn't loaded yet is requested and
+     * crossed in one jump as if it were open, so the first frames show what lies behind it.
+     */
+    class Raycaster {
+    public:
+        // Lanes per packet of each kernel
+        static const int SSE2_LANES = 2;
+        static const int AVX2_LANES = 4;
+
+        /**
+         * Kernel used unless told otherwise. The 2 lane SSE2 packets lose to the scalar loop
+         * on the CPUs we measured, so they are only used when explicitly selected.
+         */
+        static GraphicsEngine::SimdLevel default_kernel() {
+            return GraphicsEngine::detect_simd_level() == GraphicsEngine::SimdLevel::AVX2
+                ? GraphicsEngine::SimdLevel::AVX2 : GraphicsEngine::SimdLevel::Scalar;
+        }
+
+        /**
+         * Fraction bits of the fixed point DDA. Distances are stepped as 64 bit integers, so 32
+         * fraction bits cost nothing over 16 and keep the rounding of a long ray far below the
+         * spacing of the grid lines it is compared at.
+         */
+        static const int FIXED_FRACTION_BITS = 32;
+
+        // Fixed point distances are clamped to this many cells, so rays along an axis stay finite
+        static constexpr double FIXED_MAX_DISTANCE = 1 << 24;
+
+        /**
+         * Only the solid bits of map are read while stepping.
+         * @param distances Distance field of map to skip empty space with, or nullptr.
+         */
+        explicit Raycaster(const WorldMap& map, const DistanceField* distances = nullptr)
+            : world(&map), map(map.bits()), distances(distances), chunks(nullptr) {}
+
+        // Casts on the loaded chunks of a streamed map, requesting the ones rays cross into
+        explicit Raycaster(const ChunkCache& chunks)
+            : world(nullptr), map(nullptr), distances(nullptr), chunks(&chunks) {}
+
+        static void setup_ray(const Camera& camera, const RayTable& rays, int x, RayState& ray) {
+            ray.mapX = (int)camera.posX;
+            ray.mapY = (int)camera.posY;
+
+            // Initialize step and sideDist based on ray direction
+            ray.stepX = rays.ray_dir_x()[x] < 0 ? -1 : 1;
+            ray.stepY = rays.ray_dir_y()[x] < 0 ? -1 : 1;
+            ray.deltaDistX = rays.delta_dist_x()[x];
+            ray.deltaDistY = rays.delta_dist_y()[x];
+            ray.sideDistX = ray.stepX == -1 ? (camera.posX - ray.mapX) * ray.deltaDistX : (ray.mapX + 1.0 - camera.posX) * ray.deltaDistX;
+            ray.sideDistY = ray.stepY == -1 ? (camera.posY - ray.mapY) * ray.deltaDistY : (ray.mapY + 1.0 - camera.posY) * ray.deltaDistY;
+        }
+
+        // Fixed point version of setup_ray; only the setup uses floating point
+        static void setup_ray_fixed(const Camera& camera, const RayTable& rays, int x, FixedRayState& ray) {
+            RayState start;
+            setup_ray(camera, rays, x, start);
+            ray.sideDistX = to_fixed(start.sideDistX);
+            ray.sideDistY = to_fixed(start.sideDistY);
+            ray.deltaDistX = to_fixed(start.deltaDistX);
+            ray.deltaDistY = to_fixed(start.deltaDistY);
+            ray.mapX = start.mapX;
+            ray.mapY = start.mapY;
+            ray.stepX = start.stepX;
+            ray.stepY = start.stepY;
+        }
+
+        // Runs the DDA loop from the current ray state until a wall is hit
+        RayHit trace_scalar(RayState& ray) const {
+            if (chunks) return trace_chunked(ray);
+            return world->with_layout([&](const auto& layout) { return trace_scalar(layout, ray); });
+        }
+
+        // trace_scalar with integer adds and compares, so every compiler and CPU steps the same way
+        RayHit trace_fixed(FixedRayState& ray) const {
+            if (chunks) return trace_chunked(ray);
+            return world->with_layout([&](const auto& layout) { return trace_fixed(layout, ray); });
+        }
+
+        /**
+         * Casts the rays of screen columns [x_begin, x_end) and writes one hit per column.
+         * @param rays Ray table updated for this camera and screen width.
+         * @param level Kernel to use, normally the result of GraphicsEngine::detect_simd_level().
+         *              Skipping empty space and streamed maps take the scalar loop whatever the level.
+         */
+        void cast_columns(const Camera& camera, const RayTable& rays, int x_begin, int x_end,
+                          RayHit* hits, GraphicsEngine::SimdLevel level) const {
+            if (chunks) {
+                for (int x = x_begin; x < x_end; x++) {
+                    RayState ray;
+                    setup_ray(camera, rays, x, ray);
+                    hits[x - x_begin] = trace_chunked(ray);
+                }
+                return;
+            }
+            world->with_layout([&](const auto& layout) { cast_columns(layout, camera, rays, x_begin, x_end, hits, level); });
+        }
+
+        /**
+         * cast_columns on the fixed point DDA. The hit cells and sides match the double path; the
+         * distances differ from it in the last bits.
+         */
+        void cast_columns_fixed(const Camera& camera, const RayTable& rays, int x_begin, int x_end, RayHit* hits) const {
+            if (chunks) {
+                for (int x = x_begin; x < x_end; x++) {
+                    FixedRayState ray;
+                    setup_ray_fixed(camera, rays, x, ray);
+                    hits[x - x_begin] = trace_chunked(ray);
+                }
+                return;
+            }
+            world->with_layout([&](const auto& layout) {
+                for (int x = x_begin; x < x_end; x++) {
+                    FixedRayState ray;
+                    setup_ray_fixed(camera, rays, x, ray);
+                    hits[x - x_begin] = trace_fixed(layout, ray);
+                }
+            });
+        }
+
+    private:
+        template <typename Layout>
+        void cast_columns(const Layout& layout, const Camera& camera, const RayTable& rays, int x_begin, int x_end,
+                          RayHit* hits, GraphicsEngine::SimdLevel level) const {
+            if (distances) level = GraphicsEngine::SimdLevel::Scalar;
+            int x = x_begin;
+#ifdef COOLGAME_X86
+            if (level == GraphicsEngine::SimdLevel::AVX2) {
+                for (; x + AVX2_LANES <= x_end; x += AVX2_LANES) {
+                    cast_packet_avx2(layout, camera, rays, x, hits + (x - x_begin));
+                }
+            }
+            else if (level == GraphicsEngine::SimdLevel::SSE2) {
+                for (; x + SSE2_LANES <= x_end; x += SSE2_LANES) {
+                    cast_packet_sse2(layout, camera, rays, x, hits + (x - x_begin));
+                }
+            }
+#endif
+            // Scalar path for the remainder (and for CPUs without SIMD)
+            for (; x < x_end; x++) {
+                RayState ray;
+                setup_ray(camera, rays, x, ray);
+                hits[x - x_begin] = trace_scalar(layout, ray);
+            }
+        }
+
+        template <typename Layout>
+        RayHit trace_scalar(const Layout& layout, RayState& ray) const {
+            int steps = 0;
+            int side = step_to_wall(layout, ray, steps);
+            return finish(ray, side, steps);
+        }
+
+        template <typename Layout>
+        RayHit trace_fixed(const Layout& layout, FixedRayState& ray) const {
+            int steps = 0;
+            int side = step_to_wall(layout, ray, steps);
+            return finish(ray, side, steps);
+        }
+
+        template <typename State>
+        RayHit trace_chunked(State& ray) const {
+            int steps = 0;
+            int side = step_through_chunks(ray, steps);
+            return finish(ray, side, steps);
+        }
+
+        // DDA Algorithm, shared by the double and fixed point states. Returns the side that was hit.
+        template <typename Layout, typename State>
+        int step_to_wall(const Layout& layout, State& ray, int& steps) const {
+            int hit = 0, side = 0;
+            int wait = 0;  // Steps before the distance field can allow a jump again
+            const int lastX = world->get_width() - 1, lastY = world->get_height() - 1;
+            while (!hit) {
+                if (distances && --wait < 0) {
+                    // Distances change by at most 1 per step, so near walls the next lookups are skipped too
+                    int distance = distances->at_cell(layout.index(ray.mapX, ray.mapY));
+                    if (distance > MIN_JUMP_RADIUS) {
+                        // Jumps never reach the border cells, so even a wrong field (a map file's distances
+                        // aren't checked on load) keeps rays on the map; it can still jump them over walls
+                        int radius = std::min(std::min(distance - 1, std::min(ray.mapX, lastX - ray.mapX) - 1),
+                                              std::min(ray.mapY, lastY - ray.mapY) - 1);
+                        skip_empty(ray, radius, radius);
+                        steps++;
+                        wait = 0;
+                    }
+                    else wait = MIN_JUMP_RADIUS - distance;
+                }
+
+                side = ray.sideDistX < ray.sideDistY ? 0 : 1;
+                if (side == 0) {
+                    ray.sideDistX += ray.deltaDistX;
+                    ray.mapX += ray.stepX;
+                }
+                else {
+                    ray.sideDistY += ray.deltaDistY;
+                    ray.mapY += ray.stepY;
+                }
+                hit = solid(layout.index(ray.mapX, ray.mapY));
+                steps++;
+            }
+            return side;
+        }
+
+        /**
+         * step_to_wall on a streamed map. Off the map counts as solid, like a WorldMap's border.
+         * Rays entering a chunk that isn't loaded jump to its far side.
+         */
+        template <typename State>
+        int step_through_chunks(State& ray, int& steps) const {
+            const unsigned width = (unsigned)chunks->get_width(), height = (unsigned)chunks->get_height();
+            int chunkX = -1, chunkY = -1;
+            const Chunk* chunk = nullptr;
+            while (true) {
+                int side = ray.sideDistX < ray.sideDistY ? 0 : 1;
+                if (side == 0) {
+                    ray.sideDistX += ray.deltaDistX;
+                    ray.mapX += ray.stepX;
+                }
+                else {
+                    ray.sideDistY += ray.deltaDistY;
+                    ray.mapY += ray.stepY;
+                }
+                steps++;
+                if ((unsigned)ray.mapX >= width || (unsigned)ray.mapY >= height) return side;
+
+                if ((ray.mapX >> Chunk::BITS) != chunkX || (ray.mapY >> Chunk::BITS) != chunkY) {
+                    chunkX = ray.mapX >> Chunk::BITS;
+                    chunkY = ray.mapY >> Chunk::BITS;
+                    chunk = chunks->lookup(chunkX, chunkY);
+                }
+                const int cellX = ray.mapX & Chunk::MASK, cellY = ray.mapY & Chunk::MASK;
+                if (chunk) {
+                    if (chunk->solid(cellX, cellY)) return side;
+                }
+                else {
+                    // Cells left ahead of the ray in the chunk, along each axis
+                    skip_empty(ray, ray.stepX > 0 ? Chunk::MASK - cellX : cellX, ray.stepY > 0 ? Chunk::MASK - cellY : cellY);
+                }
+            }
+        }
+
+        /**
+         * Takes all the steps step_to_wall would take inside the open rectangle that reaches
+         * radiusX cells ahead of the ray's cell in x and radiusY in y. The ray leaves it with its
+         * (radiusX + 1)th x or (radiusY + 1)th y step, whichever comes first; on a tie the y step
+         * is taken first, as in step_to_wall.
+         */
+        template <typename State>
+        static void skip_empty(State& ray, int radiusX, int radiusY) {
+            // A radius of 0 leaves at the next step; 0 times an infinite delta is not a number
+            auto exitX = radiusX ? ray.sideDistX + radiusX * ray.deltaDistX : ray.sideDistX;
+            auto exitY = radiusY ? ray.sideDistY + radiusY * ray.deltaDistY : ray.sideDistY;
+            int stepsX, stepsY;
+            if (exitX < exitY) {
+                stepsX = radiusX;
+                stepsY = steps_before(ray.sideDistY, ray.deltaDistY, exitX, true, radiusY);
+            }
+            else {
+                stepsY = radiusY;
+                stepsX = steps_before(ray.sideDistX, ray.deltaDistX, exitY, false, radiusX);
+            }
+
+            // Skipped when 0, an infinite delta times 0 is not a number
+            if (stepsX) {
+                ray.sideDistX += stepsX * ray.deltaDistX;
+                ray.mapX += stepsX * ray.stepX;
+            }
+            if (stepsY) {
+                ray.sideDistY += stepsY * ray.deltaDistY;
+                ray.mapY += stepsY * ray.stepY;
+            }
+        }
+
+        /**
+         * Number of the steps at start, start + delta, start + 2 * delta... that come before time
+         * (or at it, if inclusive), at most limit. Rounding may undercount, which only makes the
+         * jump shorter; counting a step the ray doesn't take could skip a wall.
+         */
+        static int steps_before(double start, double delta, double time, bool inclusive, int limit) {
+            if (!(inclusive ? start <= time : start < time)) return 0;
+            double steps = (time - start) / delta;
+            if (!(steps < limit)) return limit;
+
+            // Not negative, so truncating is floor
+            int whole = (int)steps;
+            if (inclusive) return std::min(whole + 1, limit);
+            return whole < steps ? whole + 1 : whole;
+        }
+
+        static int steps_before(int64_t start, int64_t delta, int64_t time, bool inclusive, int limit) {
+            if (!(inclusive ? start <= time : start < time)) return 0;
+            int64_t steps = inclusive ? (time - start) / delta + 1 : (time - start + delta - 1) / delta;
+            return steps < limit ? (int)steps : limit;
+        }
+
+        bool solid(size_t cell) const {
+            return (map[cell / 64] >> (cell % 64)) & 1;
+        }
+
+        // Smaller open squares are stepped through, a jump costs more than a few steps
+        static const int MIN_JUMP_RADIUS = 2;
+
+        static constexpr double FIXED_ONE = double(int64_t(1) << FIXED_FRACTION_BITS);
+
+        static int64_t to_fixed(double distance) {
+            return std::llround(std::min(distance, FIXED_MAX_DISTANCE) * FIXED_ONE);
+        }
+
+        static RayHit finish(const RayState& ray, int side, int steps) {
+            // Calculate wall distance
+            double wallDist = side == 0 ? (ray.sideDistX - ray.deltaDistX) : (ray.sideDistY - ray.deltaDistY);
+            return RayHit{ ray.mapX, ray.mapY, side, steps, wallDist };
+        }
+
+        static RayHit finish(const FixedRayState& ray, int side, int steps) {
+            int64_t wallDist = side == 0 ? (ray.sideDistX - ray.deltaDistX) : (ray.sideDistY - ray.deltaDistY);
+            return RayHit{ ray.mapX, ray.mapY, side, steps, wallDist / FIXED_ONE };
+        }
+
+#ifdef COOLGAME_X86
+        /**
+         * Steps 4 rays together with masked adds. Lanes that hit a wall are frozen while the
+         * others keep stepping; once the packet has diverged down to a single live lane that
+         * lane finishes on the scalar loop from its current state.
+         */
+        template <typename Layout>
+        COOLGAME_TARGET("avx2")
+        void cast_packet_avx2(const Layout& layout, const Camera& camera, const RayTable& rays, int x, RayHit* hits) const {
+            // Same operations in the same order as setup_ray, one lane per column
+            const int mapX = (int)camera.posX, mapY = (int)camera.posY;
+            __m256d negX = _mm256_cmp_pd(_mm256_loadu_pd(rays.ray_dir_x() + x), _mm256_setzero_pd(), _CMP_LT_OQ);
+            __m256d negY = _mm256_cmp_pd(_mm256_loadu_pd(rays.ray_dir_y() + x), _mm256_setzero_pd(), _CMP_LT_OQ);
+            __m256d vDeltaX = _mm256_loadu_pd(rays.delta_dist_x() + x);
+            __m256d vDeltaY = _mm256_loadu_pd(rays.delta_dist_y() + x);
+            __m256d vSideX = _mm256_mul_pd(_mm256_blendv_pd(_mm256_set1_pd(mapX + 1.0 - camera.posX), _mm256_set1_pd(camera.posX - mapX), negX), vDeltaX);
+            __m256d vSideY = _mm256_mul_pd(_mm256_blendv_pd(_mm256_set1_pd(mapY + 1.0 - camera.posY), _mm256_set1_pd(camera.posY - mapY), negY), vDeltaY);
+
+            // Map coordinates in 64 bit lanes, like the masks; the layout turns them into cell indices
+            __m256i vStepX = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(_mm256_set1_epi64x(1)),
+                                                                  _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), negX));
+            __m256i vStepY = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(_mm256_set1_epi64x(1)),
+                                                                  _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), negY));
+            __m256i vMapX = _mm256_set1_epi64x(mapX);
+            __m256i vMapY = _mm256_set1_epi64x(mapY);
+
+            __m256d live = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+            __m256d hitOnX = _mm256_setzero_pd();
+            __m256i vSteps = _mm256_setzero_si256();
+            int live_mask = 0xF;
+            while (true) {
+                // side == 0 lanes step in x, the others in y; frozen lanes don't move
+                vSteps = _mm256_sub_epi64(vSteps, _mm256_castpd_si256(live));
+                __m256d cmp = _mm256_cmp_pd(vSideX, vSideY, _CMP_LT_OQ);
+                __m256d xSide = _mm256_and_pd(cmp, live);
+                __m256d ySide = _mm256_andnot_pd(cmp, live);
+                vSideX = _mm256_add_pd(vSideX, _mm256_and_pd(xSide, vDeltaX));
+                vSideY = _mm256_add_pd(vSideY, _mm256_and_pd(ySide, vDeltaY));
+                vMapX = _mm256_add_epi64(vMapX, _mm256_and_si256(_mm256_castpd_si256(xSide), vStepX));
+                vMapY = _mm256_add_epi64(vMapY, _mm256_and_si256(_mm256_castpd_si256(ySide), vStepY));
+
+                // Solid bit of each cell, gathered from its 64 bit word
+                __m256i vCell = layout.index_avx2(vMapX, vMapY);
+                __m256i word = _mm256_i64gather_epi64((const long long*)map, _mm256_srli_epi64(vCell, 6), 8);
+                __m256i bit = _mm256_and_si256(_mm256_srlv_epi64(word, _mm256_and_si256(vCell, _mm256_set1_epi64x(63))), _mm256_set1_epi64x(1));
+                __m256d wall = _mm256_castsi256_pd(_mm256_cmpeq_epi64(bit, _mm256_set1_epi64x(1)));
+                int hit_mask = _mm256_movemask_pd(wall) & live_mask;
+                if (hit_mask) {
+                    __m256d hit = _mm256_and_pd(wall, live);
+                    hitOnX = _mm256_blendv_pd(hitOnX, cmp, hit);
+                    live = _mm256_andnot_pd(hit, live);
+                    live_mask &= ~hit_mask;
+                    // At most one lane left, a packet would only waste the other lanes
+                    if ((live_mask & (live_mask - 1)) == 0) break;
+                }
+            }
+
+            alignas(32) double sideX[AVX2_LANES], sideY[AVX2_LANES], deltaX[AVX2_LANES], deltaY[AVX2_LANES];
+            alignas(32) long long cellX[AVX2_LANES], cellY[AVX2_LANES], steps[AVX2_LANES];
+            _mm256_store_si256((__m256i*)steps, vSteps);
+            _mm256_store_pd(sideX, vSideX);
+            _mm256_store_pd(sideY, vSideY);
+            _mm256_store_pd(deltaX, vDeltaX);
+            _mm256_store_pd(deltaY, vDeltaY);
+            _mm256_store_si256((__m256i*)cellX, vMapX);
+            _mm256_store_si256((__m256i*)cellY, vMapY);
+            int x_side_mask = _mm256_movemask_pd(hitOnX);
+            int neg_x_mask = _mm256_movemask_pd(negX);
+            int neg_y_mask = _mm256_movemask_pd(negY);
+
+            for (int i = 0; i < AVX2_LANES; i++) {
+                RayState ray;
+                ray.sideDistX = sideX[i];
+                ray.sideDistY = sideY[i];
+                ray.deltaDistX = deltaX[i];
+                ray.deltaDistY = deltaY[i];
+                ray.mapX = (int)cellX[i];
+                ray.mapY = (int)cellY[i];
+                ray.stepX = (neg_x_mask & (1 << i)) ? -1 : 1;
+                ray.stepY = (neg_y_mask & (1 << i)) ? -1 : 1;
+                if (live_mask & (1 << i)) hits[i] = trace_scalar(layout, ray);
+                else                      hits[i] = finish(ray, (x_side_mask & (1 << i)) ? 0 : 1, 0);
+                hits[i].steps += (int)steps[i];
+            }
+        }
+
+        // Same as cast_packet_avx2 with 2 lanes, bitwise selects and scalar bit tests instead of a gather
+        template <typename Layout>
+        COOLGAME_TARGET("sse2")
+        void cast_packet_sse2(const Layout& layout, const Camera& camera, const RayTable& rays, int x, RayHit* hits) const {
+            const int mapX = (int)camera.posX, mapY = (int)camera.posY;
+            __m128d negX = _mm_cmplt_pd(_mm_loadu_pd(rays.ray_dir_x() + x), _mm_setzero_pd());
+            __m128d negY = _mm_cmplt_pd(_mm_loadu_pd(rays.ray_dir_y() + x), _mm_setzero_pd());
+            __m128d vDeltaX = _mm_loadu_pd(rays.delta_dist_x() + x);
+            __m128d vDeltaY = _mm_loadu_pd(rays.delta_dist_y() + x);
+            __m128d vSideX = _mm_mul_pd(select(negX, _mm_set1_pd(camera.posX - mapX), _mm_set1_pd(mapX + 1.0 - camera.posX)), vDeltaX);
+            __m128d vSideY = _mm_mul_pd(select(negY, _mm_set1_pd(camera.posY - mapY), _mm_set1_pd(mapY + 1.0 - camera.posY)), vDeltaY);
+
+            __m128i vStepX = _mm_castpd_si128(select(negX, _mm_castsi128_pd(_mm_set1_epi64x(-1)), _mm_castsi128_pd(_mm_set1_epi64x(1))));
+            __m128i vStepY = _mm_castpd_si128(select(negY, _mm_castsi128_pd(_mm_set1_epi64x(-1)), _mm_castsi128_pd(_mm_set1_epi64x(1))));
+            __m128i vMapX = _mm_set1_epi64x(mapX);
+            __m128i vMapY = _mm_set1_epi64x(mapY);
+
+            __m128d live = _mm_castsi128_pd(_mm_set1_epi64x(-1));
+            __m128d hitOnX = _mm_setzero_pd();
+            __m128i vSteps = _mm_setzero_si128();
+            alignas(16) long long cellX[SSE2_LANES], cellY[SSE2_LANES], steps[SSE2_LANES];
+            int live_mask = 0x3;
+            while (true) {
+                vSteps = _mm_sub_epi64(vSteps, _mm_castpd_si128(live));
+                __m128d cmp = _mm_cmplt_pd(vSideX, vSideY);
+                __m128d xSide = _mm_and_pd(cmp, live);
+                __m128d ySide = _mm_andnot_pd(cmp, live);
+                vSideX = _mm_add_pd(vSideX, _mm_and_pd(xSide, vDeltaX));
+                vSideY = _mm_add_pd(vSideY, _mm_and_pd(ySide, vDeltaY));
+                vMapX = _mm_add_epi64(vMapX, _mm_and_si128(_mm_castpd_si128(xSide), vStepX));
+                vMapY = _mm_add_epi64(vMapY, _mm_and_si128(_mm_castpd_si128(ySide), vStepY));
+
+                _mm_store_si128((__m128i*)cellX, vMapX);
+                _mm_store_si128((__m128i*)cellY, vMapY);
+                int hit_mask = ((solid(layout.index((int)cellX[0], (int)cellY[0])) ? 1 : 0) |
+                                (solid(layout.index((int)cellX[1], (int)cellY[1])) ? 2 : 0)) & live_mask;
+                if (hit_mask) {
+                    __m128d hit = _mm_castsi128_pd(_mm_set_epi64x((hit_mask & 2) ? -1 : 0, (hit_mask & 1) ? -1 : 0));
+                    hitOnX = select(hit, cmp, hitOnX);
+                    live = _mm_andnot_pd(hit, live);
+                    live_mask &= ~hit_mask;
+                    if ((live_mask & (live_mask - 1)) == 0) break;
+                }
+            }
+
+            alignas(16) double sideX[SSE2_LANES], sideY[SSE2_LANES], deltaX[SSE2_LANES], deltaY[SSE2_LANES];
+            _mm_store_si128((__m128i*)steps, vSteps);
+            _mm_store_pd(sideX, vSideX);
+            _mm_store_pd(sideY, vSideY);
+            _mm_store_pd(deltaX, vDeltaX);
+            _mm_store_pd(deltaY, vDeltaY);
+            int x_side_mask = _mm_movemask_pd(hitOnX);
+            int neg_x_mask = _mm_movemask_pd(negX);
+            int neg_y_mask = _mm_movemask_pd(negY);
+
+            for (int i = 0; i < SSE2_LANES; i++) {
+                RayState ray;
+                ray.sideDistX = sideX[i];
+                ray.sideDistY = sideY[i];
+                ray.deltaDistX = deltaX[i];
+                ray.deltaDistY = deltaY[i];
+                ray.mapX = (int)cellX[i];
+                ray.mapY = (int)cellY[i];
+                ray.stepX = (neg_x_mask & (1 << i)) ? -1 : 1;
+                ray.stepY = (neg_y_mask & (1 << i)) ? -1 : 1;
+                if (live_mask & (1 << i)) hits[i] = trace_scalar(layout, ray);
+                else                      hits[i] = finish(ray, (x_side_mask & (1 << i)) ? 0 : 1, 0);
+                hits[i].steps += (int)steps[i];
+            }
+        }
+
+        // mask ? a : b without SSE4.1 blends
+        COOLGAME_TARGET("sse2")
+        static __m128d select(__m128d mask, __m128d a, __m128d b) {
+            return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+        }
+#endif
+
+        const WorldMap* world;
+        const uint64_t* map;  // world->bits()
+        const DistanceField* distances;
+        const ChunkCache* chunks;  // Instead of world on streamed maps
+    };
+}
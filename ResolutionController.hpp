@@ -0,0 +1,86 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+
+
+namespace GraphicsEngine {
+    /**
+     * Picks the render scale from recent frame times so frames fit a time budget.
+     * Frame times are averaged over windows of WINDOW_FRAMES frames and the scale moves at
+     * most one step per window. It steps down when a window is over budget, and only steps
+     * back up when the larger scale is predicted to stay well inside the budget; the gap
+     * between the two keeps it from switching back and forth between neighboring steps.
+     */
+    class ResolutionController {
+    public:
+        // Frames averaged before every decision
+        static const int WINDOW_FRAMES = 30;
+
+        // A larger scale must be predicted at or below this fraction of the budget
+        static constexpr double UPSCALE_HEADROOM = 0.8;
+
+        // Width and height scales, largest first; every step has roughly 20% fewer pixels
+        static const int STEP_COUNT = 6;
+        static constexpr double STEPS[STEP_COUNT] = { 1.0, 0.9, 0.8, 0.7, 0.6, 0.5 };
+
+        // Budget in milliseconds per frame, 0 renders at full size
+        void set_budget(double budget_ms) {
+            budget = budget_ms;
+            reset();
+        }
+
+        double get_budget() const {
+            return budget;
+        }
+
+        /**
+         * Adds the time one frame took to render.
+         * @return True if the scale changed.
+         */
+        bool add_frame(double frame_ms) {
+            if (budget <= 0) return false;
+
+            window_sum += frame_ms;
+            if (++window_count < WINDOW_FRAMES) return false;
+            double average = window_sum / window_count;
+            window_sum = 0;
+            window_count = 0;
+
+            if (average > budget && step + 1 < STEP_COUNT) {
+                step++;
+                return true;
+            }
+            if (step > 0) {
+                // Render time grows with the pixel count
+                double growth = (STEPS[step - 1] * STEPS[step - 1]) / (STEPS[step] * STEPS[step]);
+                if (average * growth <= budget * UPSCALE_HEADROOM) {
+                    step--;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Back to full size, forgetting the frame times so far
+        void reset() {
+            step = 0;
+            window_sum = 0;
+            window_count = 0;
+        }
+
+        double get_scale() const {
+            return STEPS[step];
+        }
+
+        // Render size of a full_size window side at the current scale
+        int scaled(int full_size) const {
+            return std::max(1, (int)std::lround(full_size * STEPS[step]));
+        }
+
+    private:
+        double budget = 0;
+        int step = 0;
+        double window_sum = 0;
+        int window_count = 0;
+    };
+}
@@ -4,6 +4,59 @@ namespace Settings {
 	const int WINDOW_WIDTH = 800;
 	const int WINDOW_HEIGHT = 600;
 
+	// Threads used to raycast a frame, including the main thread (0 = one per hardware thread)
+	const int RENDER_THREADS = 0;
+
+	// Simulation ticks per second (0 = one variable length update per frame)
+	const int TICK_RATE = 120;
+	// Wait for the display refresh when presenting a frame
+	const bool VSYNC = true;
+	// Frames per second limit, mostly for when vsync is off (0 = unlimited)
+	const int FRAME_RATE_CAP = 0;
+	// Simulate the next frame on its own thread while the current one renders (adds a frame of input latency)
+	const bool PIPELINED_UPDATE = false;
+	// Time per frame in milliseconds, from input to present; slower frames are rendered at a lower resolution and scaled up (0 = always full size)
+	const double FRAME_TIME_BUDGET_MS = 8.3;
+	// Cast rays with the integer fixed point DDA, which steps the same on every compiler and CPU (toggle in game with I)
+	const bool FIXED_POINT_DDA = false;
+	// Reuse the last frame's wall hits while the camera stands still or only turns
+	const bool COLUMN_REUSE = true;
+	// Let rays jump over open space far from walls instead of stepping every cell (toggle in game with K).
+	// Pays off on large open maps; it casts without the SIMD packets, so small maps gain little.
+	const bool EMPTY_SPACE_SKIPPING = false;
+	// Map the game loads, written by mapconv; the built in worldMap below is used when it is missing
+	const char* const LEVEL_FILE = "maps/level.cmap";
+	// Order the cells of the built in map are stored in: "rowmajor", "tiled" (8x8 cell tiles) or
+	// "morton" (Z-order); map files keep the layout mapconv wrote them in. Only the access pattern
+	// of rays changes; it matters on maps too big for the cache.
+	const char* const MAP_LAYOUT = "rowmajor";
+	// Streamed maps (Game::set_chunk_source) keep up to this many megabytes of 64 x 64 cell chunks loaded
+	const int CHUNK_CACHE_MB = 64;
+	// Chunks within this many chunks of the player are loaded ahead of time; rays request the
+	// unloaded ones they cross up to CHUNK_VIEW_RADIUS away and see through them until they arrive
+	const int CHUNK_LOAD_RADIUS = 2;
+	const int CHUNK_VIEW_RADIUS = 16;
+
+	// Textured walls instead of flat colors (toggle in game with T)
+	const bool TEXTURED_WALLS = true;
+	// Draw distant walls from smaller copies of their textures (toggle in game with M)
+	const bool WALL_MIPMAPS = true;
+	// Textured floor and ceiling instead of a black background (toggle in game with F)
+	const bool FLOOR_CASTING = true;
+	// Darken surfaces with distance and the light level of their cell (toggle in game with L)
+	const bool DISTANCE_SHADING = true;
+	// Ordered dithering between shades instead of visible distance bands (toggle in game with O)
+	const bool SHADE_DITHERING = true;
+	// Color (0xRRGGBB) surfaces fade into, and the distance in cells at which fully lit ones reach it
+	const unsigned FOG_COLOR = 0x000000;
+	const double FOG_DISTANCE = 24.0;
+	// Light level of the cells outside lightSectors, 0 (dark) to 15 (full)
+	const int AMBIENT_LIGHT = 15;
+	// Size of the generated textures, a power of two
+	const int TEXTURE_SIZE = 64;
+	// wall<type>.bmp, floor.bmp and ceiling.bmp files in here replace the generated textures
+	const char* const TEXTURE_DIRECTORY = "textures";
+
     const int MAP_WIDTH = 24;
     const int MAP_HEIGHT = 24;
 
@@ -34,4 +87,24 @@ namespace Settings {
 	  {1,4,4,4,4,4,4,4,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1},
 	  {1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1}
 	};
+
+	// Where the player starts on worldMap
+	const double SPAWN_X = 22;
+	const double SPAWN_Y = 12;
+
+	// Light sectors: the cells x0..x1, y0..y1 get the light level, 0 (dark) to 15 (full)
+	const int lightSectors[][5] =
+	{
+	  {5, 7, 7, 9, 5},     // Inside the green room
+	  {17, 1, 21, 7, 9},   // White maze
+	  {4, 14, 8, 20, 11}   // Between the blue pillars
+	};
+
+	// Sprites placed in the world: x, y and texture (0 barrel, 1 pillar, 2 lamp)
+	const double sprites[][3] =
+	{
+	  {20.5, 11.5, 2}, {18.5, 4.5, 2}, {10.0, 4.5, 2}, {10.0, 12.5, 2}, {3.5, 6.5, 2}, {3.5, 20.5, 2}, {3.5, 14.5, 2}, {14.5, 20.5, 2},
+	  {18.5, 10.5, 1}, {18.5, 11.5, 1}, {18.5, 12.5, 1},
+	  {21.5, 2.5, 0}, {15.5, 1.5, 0}, {15.0, 1.8, 0}, {14.2, 1.2, 0}, {3.5, 2.5, 0}, {9.5, 15.5, 0}, {10.0, 15.1, 0}, {10.5, 15.8, 0}
+	};
 }
@@ -0,0 +1,41 @@
+#pragma once
+#include <SDL2/SDL_cpuinfo.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define COOLGAME_X86 1
+#include <immintrin.h>
+#endif
+
+// GCC and Clang only emit AVX2/SSE2 code for functions that ask for it, so the rest of
+// the build keeps the baseline instruction set and the wider paths are picked at runtime.
+#if defined(__GNUC__) || defined(__clang__)
+#define COOLGAME_TARGET(isa) __attribute__((target(isa)))
+#else
+#define COOLGAME_TARGET(isa)
+#endif
+
+
+namespace GraphicsEngine {
+    enum class SimdLevel {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    // Widest instruction set both the build and the running CPU support
+    inline SimdLevel detect_simd_level() {
+#ifdef COOLGAME_X86
+        if (SDL_HasAVX2()) return SimdLevel::AVX2;
+        if (SDL_HasSSE2()) return SimdLevel::SSE2;
+#endif
+        return SimdLevel::Scalar;
+    }
+
+    inline const char* simd_level_name(SimdLevel level) {
+        switch (level) {
+        case SimdLevel::AVX2: return "AVX2";
+        case SimdLevel::SSE2: return "SSE2";
+        default:              return "Scalar";
+        }
+    }
+}
@@ -0,0 +1,283 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "Colormap.hpp"
+#include "GraphicsEngine.hpp"
+#include "LightMap.hpp"
+#include "Raycaster.hpp"
+#include "Texture.hpp"
+
+
+namespace GameLogic {
+    // Billboard standing on the floor, always facing the camera
+    struct Sprite {
+        double x, y;
+        int texture;
+    };
+
+    /**
+     * Draws billboard sprites over the walls.
+     * project() transforms the sprites into camera space once per frame and sorts the visible ones
+     * by depth; draw_columns() then draws them near to far over a band of screen columns, clipped
+     * against the wall depth buffer. Bands are independent, so it runs on the same workers as the walls.
+     *
+     * Near to far order lets crowds stay cheap: every screen column remembers the rows that near
+     * sprites covered solidly, and farther sprites skip those rows without looking at them. A per
+     * pixel stamp keeps the other texels of near sprites from being painted over.
+     */
+    class SpriteRenderer {
+    public:
+        // Sprites closer than this are behind the camera or would cover the whole screen
+        static constexpr double NEAR_PLANE = 0.05;
+
+        /**
+         * Sets the sprite textures, indexed by Sprite::texture. Black texels are transparent.
+         * The opaque rows of every texture column are found here, once.
+         */
+        void set_textures(const std::vector<GraphicsEngine::Texture>& new_textures) {
+            textures = new_textures;
+            opaque_spans.clear();
+            for (const GraphicsEngine::Texture& texture : textures) {
+                std::vector<ColumnSpan> spans(texture.get_width());
+                for (int x = 0; x < texture.get_width(); x++) {
+                    ColumnSpan& span = spans[x];
+                    span.first = texture.get_height();
+                    span.last = -1;
+                    int opaque = 0;
+                    for (int y = 0; y < texture.get_height(); y++) {
+                        if (!(texture.get(x, y) & 0x00FFFFFFu)) continue;
+                        span.first = std::min(span.first, y);
+                        span.last = y;
+                        opaque++;
+                    }
+                    span.solid = opaque == span.last - span.first + 1;
+                }
+                opaque_spans.push_back(spans);
+            }
+        }
+
+        // Shades sprites by depth and the light level of their cell; nullptr colormaps draws them unshaded
+        void set_shading(const GraphicsEngine::ColormapTable* new_colormaps, const LightMap* new_lights, bool new_dither) {
+            colormaps = new_colormaps;
+            lights = new_lights;
+            dither = new_dither;
+        }
+
+        void project(const Camera& camera, const Sprite* sprites, int count, int screen_width, int screen_height) {
+            projected.clear();
+            covered_top.resize(screen_width);
+            covered_bottom.resize(screen_width);
+            if (textures.empty()) return;
+
+            // A new stamp marks the pixels drawn this frame; the buffer is only cleared when stamps run out
+            size_t pixel_count = (size_t)screen_width * screen_height;
+            if (drawn.size() != pixel_count || ++stamp == 0) {
+                drawn.assign(pixel_count, 0);
+                stamp = 1;
+            }
+
+            // Inverse of the camera matrix [planeX dirX; planeY dirY]
+            double invDet = 1.0 / (camera.planeX * camera.dirY - camera.dirX * camera.planeY);
+
+            for (int i = 0; i < count; i++) {
+                double spriteX = sprites[i].x - camera.posX;
+                double spriteY = sprites[i].y - camera.posY;
+                double transformX = invDet * (camera.dirY * spriteX - camera.dirX * spriteY);
+                double transformY = invDet * (-camera.planeY * spriteX + camera.planeX * spriteY);  // depth
+                if (transformY < NEAR_PLANE) continue;
+
+                ProjectedSprite sprite;
+                sprite.depth = transformY;
+                sprite.texture = (int)((unsigned)sprites[i].texture % textures.size());
+                int screenX = int((screen_width / 2) * (1 + transformX / transformY));
+                sprite.size = std::max(std::abs(int(screen_height / transformY)), 1);
+                sprite.left = -sprite.size / 2 + screenX;
+                sprite.top = -sprite.size / 2 + screen_height / 2;
+                if (sprite.left + sprite.size <= 0 || sprite.left >= screen_width) continue;
+
+                // One division per sprite, the texture is stepped in 16.16 fixed point
+                int texHeight = textures[sprite.texture].get_height();
+                sprite.tex_step = std::max(Uint32((Uint64(texHeight) << GraphicsEngine::Texture::FRACTION_BITS) / sprite.size), 1u);
+
+                if (colormaps) {
+                    int light = lights->level((int)std::floor(sprites[i].x), (int)std::floor(sprites[i].y));
+                    sprite.shade = colormaps->span(colormaps->shade(light, transformY), dither);
+                }
+
+                projected.push_back(sprite);
+            }
+
+            sort_by_depth();
+        }
+
+        /**
+         * Draws the projected sprites over the screen columns [x_begin, x_end).
+         * @param zbuffer Perpendicular wall distance of every screen column.
+         */
+        void draw_columns(GraphicsEngine::FrameBuffer& frame, const double* zbuffer, int x_begin, int x_end) {
+            const int height = frame.get_height();
+
+            // Rows [covered_top, covered_bottom) of a column are hidden behind solid sprite texels
+            for (int x = x_begin; x < x_end; x++) {
+                covered_top[x] = covered_bottom[x] = 0;
+            }
+
+            for (Uint32 index : order) {
+                const ProjectedSprite& sprite = projected[index];
+                int x_start = std::max(sprite.left, x_begin);
+                int x_stop = std::min(sprite.left + sprite.size, x_end);
+                if (x_start >= x_stop) continue;
+
+                const GraphicsEngine::Texture& texture = textures[sprite.texture];
+                const std::vector<ColumnSpan>& spans = opaque_spans[sprite.texture];
+                const int texWidth = texture.get_width();
+
+                for (int x = x_start; x < x_stop; x++) {
+                    if (sprite.depth >= zbuffer[x]) continue;
+
+                    int texX = int((long long)(x - sprite.left) * texWidth / sprite.size);
+                    const ColumnSpan& span = spans[texX];
+                    if (span.last < span.first) continue;
+
+                    // Screen rows whose texture row is inside the opaque span
+                    int y_start = sprite.top + ceil_div(Uint64(span.first) << GraphicsEngine::Texture::FRACTION_BITS, sprite.tex_step);
+                    int y_end = sprite.top + ceil_div(Uint64(span.last + 1) << GraphicsEngine::Texture::FRACTION_BITS, sprite.tex_step);
+                    y_start = std::max(y_start, 0);
+                    y_end = std::min(std::min(y_end, sprite.top + sprite.size), height);
+                    if (y_start >= y_end) continue;
+
+                    int& top = covered_top[x];
+                    int& bottom = covered_bottom[x];
+                    if (top >= bottom) {
+                        draw_span(frame, x, y_start, y_end, sprite, texture.column(texX), span.solid);
+                    }
+                    else {
+                        if (y_start >= top && y_end <= bottom) continue;  // Completely hidden
+                        draw_span(frame, x, y_start, std::min(y_end, top), sprite, texture.column(texX), span.solid);
+                        draw_span(frame, x, std::max(y_start, bottom), y_end, sprite, texture.column(texX), span.solid);
+                    }
+
+                    if (span.solid) {
+                        // Grow the covered rows, or start over if the new span hides more than the old one
+                        if (top < bottom && y_start <= bottom && y_end >= top) {
+                            top = std::min(top, y_start);
+                            bottom = std::max(bottom, y_end);
+                        }
+                        else if (top >= bottom || y_end - y_start > bottom - top) {
+                            top = y_start;
+                            bottom = y_end;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Sprites in front of the camera and on screen after the last project()
+        int visible_count() const {
+            return (int)projected.size();
+        }
+
+    private:
+        struct ProjectedSprite {
+            double depth;
+            int texture;
+            int left, top;    // Screen position of the unclipped sprite
+            int size;         // Width and height on screen
+            Uint32 tex_step;  // Texture rows per screen row, 16.16 fixed point
+            GraphicsEngine::ShadeSpan shade;  // Set when shading
+        };
+
+        // Opaque texture rows [first, last] of a texture column; solid if none in between are transparent
+        struct ColumnSpan {
+            int first, last;
+            bool solid;
+        };
+
+        static int ceil_div(Uint64 value, Uint32 divisor) {
+            return (int)((value + divisor - 1) / divisor);
+        }
+
+        // Draws the rows [y_start, y_end) of a sprite column where no nearer sprite was drawn
+        void draw_span(GraphicsEngine::FrameBuffer& frame, int x, int y_start, int y_end,
+                       const ProjectedSprite& sprite, const Uint32* column, bool solid) {
+            const int width = frame.get_width();
+            Uint32 texPos = Uint32(y_start - sprite.top) * sprite.tex_step;
+            size_t offset = (size_t)y_start * width + x;
+            Uint32* p = frame.data() + offset;
+            Uint16* d = drawn.data() + offset;
+            const bool shaded = colormaps != nullptr;
+            for (int y = y_start; y < y_end; y++, p += width, d += width, texPos += sprite.tex_step) {
+                if (*d == stamp) continue;
+                Uint32 texel = column[texPos >> GraphicsEngine::Texture::FRACTION_BITS];
+                if (solid || (texel & 0x00FFFFFFu)) {
+                    *p = shaded ? sprite.shade.at(x, y).apply(texel) : texel;
+                    *d = stamp;
+                }
+            }
+        }
+
+        /**
+         * LSD radix sort of the sprite indices, nearest first. Depths are positive, so the bits
+         * of their float values order the same way as the values. Passes over bytes that are
+         * equal for every key are skipped, which is most of them in a typical frame.
+         */
+        void sort_by_depth() {
+            const size_t count = projected.size();
+            keys.resize(count);
+            order.resize(count);
+            key_scratch.resize(count);
+            order_scratch.resize(count);
+
+            for (size_t i = 0; i < count; i++) {
+                float depth = (float)projected[i].depth;
+                std::memcpy(&keys[i], &depth, sizeof(depth));
+                order[i] = (Uint32)i;
+            }
+
+            for (int shift = 0; shift < 32; shift += 8) {
+                size_t histogram[256] = {};
+                for (size_t i = 0; i < count; i++) histogram[(keys[i] >> shift) & 0xFF]++;
+                if (count == 0 || histogram[(keys[0] >> shift) & 0xFF] == count) continue;
+
+                size_t offset = 0;
+                for (size_t& bucket : histogram) {
+                    size_t size = bucket;
+                    bucket = offset;
+                    offset += size;
+                }
+                for (size_t i = 0; i < count; i++) {
+                    size_t to = histogram[(keys[i] >> shift) & 0xFF]++;
+                    key_scratch[to] = keys[i];
+                    order_scratch[to] = order[i];
+                }
+                keys.swap(key_scratch);
+                order.swap(order_scratch);
+            }
+        }
+
+        const GraphicsEngine::ColormapTable* colormaps = nullptr;
+        const LightMap* lights = nullptr;
+        bool dither = false;
+
+        std::vector<GraphicsEngine::Texture> textures;
+        std::vector<std::vector<ColumnSpan>> opaque_spans;  // Per texture, per texture column
+        std::vector<ProjectedSprite> projected;
+
+        // Covered rows of every screen column; each band only touches its own columns
+        std::vector<int> covered_top;
+        std::vector<int> covered_bottom;
+
+        // Pixels holding a sprite texel this frame are set to stamp
+        std::vector<Uint16> drawn;
+        Uint16 stamp = 0;
+
+        // Sort keys and the resulting draw order, kept between frames so sorting doesn't allocate
+        std::vector<Uint32> keys;
+        std::vector<Uint32> order;
+        std::vector<Uint32> key_scratch;
+        std::vector<Uint32> order_scratch;
+    };
+}
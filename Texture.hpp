@@ -0,0 +1,135 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+#include "Pixel.hpp"
+
+
+namespace GraphicsEngine {
+    /**
+     * 32-bit ARGB texture stored transposed: texel (x, y) lives at x * height + y, so a wall
+     * slice, which walks down one texture column, reads contiguous memory.
+     * The height is a power of two, which lets the renderer wrap texture rows with a mask.
+     */
+    class Texture {
+    public:
+        // Texture coordinates are stepped in 16.16 fixed point
+        static const int FRACTION_BITS = 16;
+
+        Texture()
+            : width(0), height(0) {}
+
+        Texture(int width, int height)
+            : width(width), height(height), texels(static_cast<size_t>(width) * height, 0xFF000000) {}
+
+        static bool is_power_of_two(int value) {
+            return value > 0 && (value & (value - 1)) == 0;
+        }
+
+        /**
+         * Builds a texture from pixel(x, y) -> 0xAARRGGBB.
+         */
+        template <typename PixelFunction>
+        static Texture generate(int width, int height, PixelFunction pixel) {
+            Texture texture(width, height);
+            for (int x = 0; x < width; x++) {
+                for (int y = 0; y < height; y++) {
+                    texture.set(x, y, pixel(x, y));
+                }
+            }
+            return texture;
+        }
+
+        /**
+         * Loads a BMP file into texture. Fails on unreadable files and heights that are not a power of two.
+         */
+        static bool load_bmp(const std::string& path, Texture& texture) {
+            SDL_Surface* loaded = SDL_LoadBMP(path.c_str());
+            if (!loaded) return false;
+
+            SDL_Surface* surface = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ARGB8888, 0);
+            SDL_FreeSurface(loaded);
+            if (!surface) return false;
+
+            if (!is_power_of_two(surface->h)) {
+                std::cout << path << ": texture height must be a power of two" << std::endl;
+                SDL_FreeSurface(surface);
+                return false;
+            }
+
+            texture = Texture(surface->w, surface->h);
+            SDL_LockSurface(surface);
+            for (int y = 0; y < surface->h; y++) {
+                const Uint32* row = reinterpret_cast<const Uint32*>(static_cast<const Uint8*>(surface->pixels) + y * surface->pitch);
+                for (int x = 0; x < surface->w; x++) {
+                    texture.set(x, y, row[x] | 0xFF000000u);
+                }
+            }
+            SDL_UnlockSurface(surface);
+            SDL_FreeSurface(surface);
+            return true;
+        }
+
+        /**
+         * This texture followed by ever smaller copies, each half the size of the one before
+         * (2x2 box filter), down to a single texel row or column. Level n is meant for walls
+         * drawn at 1 / 2^n of the texture height or less.
+         */
+        std::vector<Texture> build_mip_chain() const {
+            std::vector<Texture> chain;
+            chain.push_back(*this);
+            while (chain.back().width > 1 && chain.back().height > 1) {
+                const Texture& source = chain.back();
+                Texture level(source.width / 2, source.height / 2);
+                for (int x = 0; x < level.width; x++) {
+                    for (int y = 0; y < level.height; y++) {
+                        Pixel a = source.get(2 * x, 2 * y), b = source.get(2 * x + 1, 2 * y);
+                        Pixel c = source.get(2 * x, 2 * y + 1), d = source.get(2 * x + 1, 2 * y + 1);
+                        level.set(x, y, average(a, b, c, d));
+                    }
+                }
+                chain.push_back(level);
+            }
+            return chain;
+        }
+
+        void set(int x, int y, Pixel pixel) {
+            texels[static_cast<size_t>(x) * height + y] = pixel;
+        }
+
+        Pixel get(int x, int y) const {
+            return texels[static_cast<size_t>(x) * height + y];
+        }
+
+        // The height texels of column x, top to bottom
+        const Pixel* column(int x) const {
+            return texels.data() + static_cast<size_t>(x) * height;
+        }
+
+        int get_width() const {
+            return width;
+        }
+
+        int get_height() const {
+            return height;
+        }
+
+    private:
+        // Channel wise rounded average of four ARGB pixels
+        static Pixel average(Pixel a, Pixel b, Pixel c, Pixel d) {
+            Uint32 result = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                Uint32 sum = ((a >> shift) & 0xFF) + ((b >> shift) & 0xFF) + ((c >> shift) & 0xFF) + ((d >> shift) & 0xFF);
+                result |= ((sum + 2) / 4) << shift;
+            }
+            return result;
+        }
+
+        int width;
+        int height;
+        std::vector<Pixel> texels;
+    };
+}
@@ -0,0 +1,215 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Profiler.hpp"
+
+
+namespace GraphicsEngine {
+    /**
+     * Persistent pool of worker threads for data parallel frame work.
+     * The calling thread always takes part, so a pool of N threads starts N - 1 workers.
+     */
+    class WorkerPool {
+    public:
+        // Every thread gets a few bands so a slow band doesn't leave the others idle
+        static const int BANDS_PER_THREAD = 4;
+
+        /**
+         * @param thread_count Threads working on a job, including the caller. 0 uses one per hardware thread.
+         */
+        explicit WorkerPool(int thread_count = 0) {
+            set_thread_count(thread_count);
+        }
+
+        ~WorkerPool() {
+            stop_workers();
+        }
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        int get_thread_count() const {
+            return static_cast<int>(threads.size()) + 1;
+        }
+
+        void set_thread_count(int thread_count) {
+            if (thread_count <= 0) {
+                thread_count = static_cast<int>(std::thread::hardware_concurrency());
+                if (thread_count <= 0) thread_count = 1;
+            }
+            if (thread_count == get_thread_count() && !threads.empty()) return;
+
+            stop_workers();
+            stopping = false;
+            for (int i = 1; i < thread_count; i++) {
+                threads.emplace_back([this, i, start = generation]() { worker_loop(i, start); });
+            }
+        }
+
+        /**
+         * Splits [0, count) into contiguous bands and calls job(begin, end) once per band.
+         * Band boundaries only depend on count and the thread count, and every index is handled
+         * by exactly one call, so jobs that write disjoint outputs give deterministic results.
+         * Blocks until all bands are done.
+         */
+        void parallel_for(int count, const std::function<void(int, int)>& job) {
+            if (count <= 0) return;
+
+            int bands = std::min(count, get_thread_count() * BANDS_PER_THREAD);
+            if (threads.empty() || bands == 1) {
+                job(0, count);
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                current_job = &job;
+                job_count = count;
+                band_count = bands;
+                next_band = 0;
+                busy_workers = static_cast<int>(threads.size());
+                generation++;
+            }
+            work_ready.notify_all();
+
+            run_bands();
+
+            std::unique_lock<std::mutex> lock(mutex);
+            // Once every worker has checked in, all claimed bands are finished as well
+            work_done.wait(lock, [this]() { return busy_workers == 0; });
+            current_job = nullptr;
+        }
+
+    private:
+        void worker_loop(int worker_index, unsigned long long seen_generation) {
+            PROFILE_THREAD_NAME("worker " + std::to_string(worker_index));
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    work_ready.wait(lock, [&]() { return stopping || generation != seen_generation; });
+                    if (stopping) return;
+                    seen_generation = generation;
+                }
+                run_bands();
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--busy_workers == 0) work_done.notify_one();
+            }
+        }
+
+        // Claims bands until none are left; shared by the workers and the calling thread
+        void run_bands() {
+            while (true) {
+                int band = next_band.fetch_add(1);
+                if (band >= band_count) break;
+
+                int begin = static_cast<int>(static_cast<long long>(band) * job_count / band_count);
+                int end = static_cast<int>(static_cast<long long>(band + 1) * job_count / band_count);
+                (*current_job)(begin, end);
+            }
+        }
+
+        void stop_workers() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            work_ready.notify_all();
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            threads.clear();
+        }
+
+        std::vector<std::thread> threads;
+        std::mutex mutex;
+        std::condition_variable work_ready;
+        std::condition_variable work_done;
+        bool stopping = false;
+        unsigned long long generation = 0;
+
+        // Current job, only valid while parallel_for is running
+        const std::function<void(int, int)>* current_job = nullptr;
+        int job_count = 0;
+        int band_count = 0;
+        std::atomic<int> next_band{ 0 };
+        int busy_workers = 0;
+    };
+
+
+    /**
+     * A single persistent thread that runs one job at a time next to the caller,
+     * e.g. simulating the next frame while the current one is rendered.
+     */
+    class BackgroundTask {
+    public:
+        explicit BackgroundTask(const std::string& thread_name)
+            : thread([this, thread_name]() {
+                  PROFILE_THREAD_NAME(thread_name);
+                  task_loop();
+              }) {}
+
+        ~BackgroundTask() {
+            wait();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            job_ready.notify_one();
+            thread.join();
+        }
+
+        BackgroundTask(const BackgroundTask&) = delete;
+        BackgroundTask& operator=(const BackgroundTask&) = delete;
+
+        // Starts a job; the previous one must have been waited for
+        void run_async(std::function<void()> job) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                current_job = std::move(job);
+                busy = true;
+            }
+            job_ready.notify_one();
+        }
+
+        // Blocks until the running job, if any, is done
+        void wait() {
+            std::unique_lock<std::mutex> lock(mutex);
+            job_done.wait(lock, [this]() { return !busy; });
+        }
+
+    private:
+        void task_loop() {
+            while (true) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    job_ready.wait(lock, [this]() { return stopping || busy; });
+                    if (stopping) return;
+                    job = std::move(current_job);
+                }
+                job();
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    busy = false;
+                }
+                job_done.notify_all();
+            }
+        }
+
+        std::mutex mutex;
+        std::condition_variable job_ready;
+        std::condition_variable job_done;
+        std::function<void()> current_job;
+        bool busy = false;
+        bool stopping = false;
+        std::thread thread;
+    };
+}
@@ -0,0 +1,319 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "Simd.hpp"
+
+
+namespace GameLogic {
+    // Order the cells of a WorldMap are stored in
+    enum class MapLayout {
+        RowMajor,  // x * height + y, like the int maps
+        Tiled,     // 8 x 8 tiles, each one word of the solid bits
+        Morton     // Z-order, x and y bits interleaved
+    };
+
+    inline const char* map_layout_name(MapLayout layout) {
+        switch (layout) {
+        case MapLayout::Tiled:  return "tiled";
+        case MapLayout::Morton: return "morton";
+        default:                return "rowmajor";
+        }
+    }
+
+    inline bool parse_map_layout(const char* name, MapLayout& layout) {
+        for (MapLayout candidate : { MapLayout::RowMajor, MapLayout::Tiled, MapLayout::Morton }) {
+            if (std::strcmp(name, map_layout_name(candidate)) == 0) {
+                layout = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Cell index accessors of the layouts, for code that is instantiated per layout so its
+     * inner loops index without branching on it. index() takes cells inside the map; size()
+     * is the number of cells storage needs, padding included.
+     */
+    struct RowMajorLayout {
+        RowMajorLayout(int width, int height)
+            : width(width), height(height) {}
+
+        size_t size() const {
+            return (size_t)width * height;
+        }
+
+        size_t index(int x, int y) const {
+            return (size_t)x * height + y;
+        }
+
+#ifdef COOLGAME_X86
+        // index() of 4 cells, coordinates in 64 bit lanes
+        COOLGAME_TARGET("avx2")
+        __m256i index_avx2(__m256i x, __m256i y) const {
+            return _mm256_add_epi64(_mm256_mul_epu32(x, _mm256_set1_epi64x(height)), y);
+        }
+#endif
+
+        int width, height;
+    };
+
+    // Diagonal and x-going rays stay in one cache line for up to 8 cells of the tile
+    struct TiledLayout {
+        static const int TILE_BITS = 3;  // 8 x 8 cells, 64 solid bits
+
+        TiledLayout(int width, int height)
+            : tilesX((width + 7) >> TILE_BITS), tilesY((height + 7) >> TILE_BITS) {}
+
+        size_t size() const {
+            return (size_t)tilesX * tilesY << (2 * TILE_BITS);
+        }
+
+        size_t index(int x, int y) const {
+            size_t tile = (size_t)(x >> TILE_BITS) * tilesY + (y >> TILE_BITS);
+            return (tile << (2 * TILE_BITS)) | ((x & 7) << TILE_BITS) | (y & 7);
+        }
+
+#ifdef COOLGAME_X86
+        COOLGAME_TARGET("avx2")
+        __m256i index_avx2(__m256i x, __m256i y) const {
+            const __m256i low = _mm256_set1_epi64x(7);
+            __m256i tile = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, TILE_BITS), _mm256_set1_epi64x(tilesY)),
+                                            _mm256_srli_epi64(y, TILE_BITS));
+            __m256i inTile = _mm256_or_si256(_mm256_slli_epi64(_mm256_and_si256(x, low), TILE_BITS), _mm256_and_si256(y, low));
+            return _mm256_or_si256(_mm256_slli_epi64(tile, 2 * TILE_BITS), inTile);
+        }
+#endif
+
+        int tilesX, tilesY;
+    };
+
+    // Neighbors in any direction are mostly close in memory; the map is padded to a power of two square
+    struct MortonLayout {
+        MortonLayout(int width, int height)
+            : side(1) {
+            while (side < width || side < height) side *= 2;
+        }
+
+        size_t size() const {
+            return (size_t)side * side;
+        }
+
+        size_t index(int x, int y) const {
+            return (size_t)(spread((uint32_t)x) << 1 | spread((uint32_t)y));
+        }
+
+#ifdef COOLGAME_X86
+        COOLGAME_TARGET("avx2")
+        __m256i index_avx2(__m256i x, __m256i y) const {
+            return _mm256_or_si256(_mm256_slli_epi64(spread_avx2(x), 1), spread_avx2(y));
+        }
+#endif
+
+        int side;
+
+    private:
+        // The bits of v at the even bit positions
+        static uint64_t spread(uint32_t v) {
+            uint64_t bits = v;
+            bits = (bits | bits << 16) & 0x0000FFFF0000FFFFull;
+            bits = (bits | bits << 8) & 0x00FF00FF00FF00FFull;
+            bits = (bits | bits << 4) & 0x0F0F0F0F0F0F0F0Full;
+            bits = (bits | bits << 2) & 0x3333333333333333ull;
+            bits = (bits | bits << 1) & 0x5555555555555555ull;
+            return bits;
+        }
+
+#ifdef COOLGAME_X86
+        COOLGAME_TARGET("avx2")
+        static __m256i spread_avx2(__m256i bits) {
+            bits = _mm256_and_si256(_mm256_or_si256(bits, _mm256_slli_epi64(bits, 16)), _mm256_set1_epi64x(0x0000FFFF0000FFFFll));
+            bits = _mm256_and_si256(_mm256_or_si256(bits, _mm256_slli_epi64(bits, 8)), _mm256_set1_epi64x(0x00FF00FF00FF00FFll));
+            bits = _mm256_and_si256(_mm256_or_si256(bits, _mm256_slli_epi64(bits, 4)), _mm256_set1_epi64x(0x0F0F0F0F0F0F0F0Fll));
+            bits = _mm256_and_si256(_mm256_or_si256(bits, _mm256_slli_epi64(bits, 2)), _mm256_set1_epi64x(0x3333333333333333ll));
+            bits = _mm256_and_si256(_mm256_or_si256(bits, _mm256_slli_epi64(bits, 1)), _mm256_set1_epi64x(0x5555555555555555ll));
+            return bits;
+        }
+#endif
+    };
+
+    /**
+     * The map as two grids: one bit per cell telling whether it is solid, which is all the DDA
+     * and collision tests read, and a byte per cell with its material (the wall type, 0 for
+     * open cells) that is only read once a ray has hit. The bits of a 4096 x 4096 map take
+     * 2 MB, so hit tests stay in cache where an int per cell would take 64 MB.
+     *
+     * Both grids store the cells in the map's MapLayout. Code that reads cells per step
+     * instantiates itself for the layout's accessor (see with_layout()); solid(), material()
+     * and cell_index() work in any layout. A cell is solid when its material is not 0.
+     *
+     * The grids are either owned or a read only view of memory owned elsewhere, such as a
+     * mapped map file (see MapFile).
+     */
+    class WorldMap {
+    public:
+        // Largest material a cell can have
+        static const int MAX_MATERIAL = 255;
+
+        WorldMap()
+            : WorldMap(0, 0) {}
+
+        // Map of open cells
+        WorldMap(int width, int height, MapLayout layout = MapLayout::RowMajor)
+            : width(width), height(height), layout(layout) {
+            words.resize(word_count());
+            materials.resize(cell_count());
+            attach();
+        }
+
+        /**
+         * @param cells Row-major wall types, indexed as cells[x * height + y]; 0 is open.
+         */
+        WorldMap(const int* cells, int width, int height, MapLayout layout = MapLayout::RowMajor)
+            : WorldMap(width, height, layout) {
+            for (int x = 0; x < width; x++) {
+                for (int y = 0; y < height; y++) set(x, y, cells[(size_t)x * height + y]);
+            }
+        }
+
+        /**
+         * View of grids stored in layout elsewhere, word_count() solid words and cell_count()
+         * materials, kept alive by owner. Read only.
+         */
+        WorldMap(int width, int height, MapLayout layout, const uint64_t* solid_bits, const uint8_t* cell_materials,
+                 std::shared_ptr<const void> owner)
+            : width(width), height(height), layout(layout),
+              solid_bits(solid_bits), cell_materials(cell_materials), owner(std::move(owner)) {}
+
+        WorldMap(const WorldMap& other)
+            : width(other.width), height(other.height), layout(other.layout), words(other.words), materials(other.materials),
+              solid_bits(other.solid_bits), cell_materials(other.cell_materials), owner(other.owner) {
+            attach();
+        }
+
+        WorldMap& operator=(const WorldMap& other) {
+            WorldMap copy(other);
+            return *this = std::move(copy);
+        }
+
+        // Moving a vector keeps its buffer, so the pointers stay valid
+        WorldMap(WorldMap&&) = default;
+        WorldMap& operator=(WorldMap&&) = default;
+
+        // The same cells in another layout
+        WorldMap relayout(MapLayout new_layout) const {
+            WorldMap map(width, height, new_layout);
+            for (int x = 0; x < width; x++) {
+                for (int y = 0; y < height; y++) map.set(x, y, material(x, y));
+            }
+            return map;
+        }
+
+        void set(int x, int y, int material) {
+            if (material < 0 || material > MAX_MATERIAL) throw std::runtime_error("Map cells must be between 0 and 255");
+            if (owner) throw std::runtime_error("Mapped maps are read only");
+
+            size_t cell = cell_index(x, y);
+            materials[cell] = (uint8_t)material;
+            if (material) words[cell / 64] |= uint64_t(1) << (cell % 64);
+            else          words[cell / 64] &= ~(uint64_t(1) << (cell % 64));
+        }
+
+        bool solid(int x, int y) const {
+            return solid_cell(cell_index(x, y));
+        }
+
+        // Solid bit of a cell by its index in the layout
+        bool solid_cell(size_t cell) const {
+            return (solid_bits[cell / 64] >> (cell % 64)) & 1;
+        }
+
+        int material(int x, int y) const {
+            return cell_materials[cell_index(x, y)];
+        }
+
+        /**
+         * Whether every cell on the edge of the map is solid. The DDA and collision tests don't
+         * bounds check cells, they rely on rays and the player stopping at the border.
+         */
+        bool has_solid_border() const {
+            if (width < 1 || height < 1) return false;
+            for (int x = 0; x < width; x++) {
+                if (!solid(x, 0) || !solid(x, height - 1)) return false;
+            }
+            for (int y = 0; y < height; y++) {
+                if (!solid(0, y) || !solid(width - 1, y)) return false;
+            }
+            return true;
+        }
+
+        size_t cell_index(int x, int y) const {
+            return with_layout([&](const auto& accessor) { return accessor.index(x, y); });
+        }
+
+        /**
+         * Calls f with the accessor of the map's layout (RowMajorLayout, TiledLayout or
+         * MortonLayout), so f can be a generic lambda that is compiled once per layout.
+         */
+        template <typename F>
+        auto with_layout(F&& f) const -> decltype(f(RowMajorLayout(0, 0))) {
+            switch (layout) {
+            case MapLayout::Tiled:  return f(TiledLayout(width, height));
+            case MapLayout::Morton: return f(MortonLayout(width, height));
+            default:                return f(RowMajorLayout(width, height));
+            }
+        }
+
+        int get_width() const {
+            return width;
+        }
+
+        int get_height() const {
+            return height;
+        }
+
+        MapLayout get_layout() const {
+            return layout;
+        }
+
+        // Cells the grids hold in the layout, padding included
+        size_t cell_count() const {
+            return with_layout([](const auto& accessor) { return accessor.size(); });
+        }
+
+        size_t word_count() const {
+            return (cell_count() + 63) / 64;
+        }
+
+        // Solid bits of cells 64 * i to 64 * i + 63 in word i, lowest bit first
+        const uint64_t* bits() const {
+            return solid_bits;
+        }
+
+        // Material of every cell, cell_count() bytes in the layout
+        const uint8_t* material_data() const {
+            return cell_materials;
+        }
+
+    private:
+        // Points the grids at the owned vectors, unless this is a view
+        void attach() {
+            if (owner) return;
+            solid_bits = words.data();
+            cell_materials = materials.data();
+        }
+
+        int width;
+        int height;
+        MapLayout layout;
+        std::vector<uint64_t> words;
+        std::vector<uint8_t> materials;
+        const uint64_t* solid_bits = nullptr;  // words, or the viewed grids
+        const uint8_t* cell_materials = nullptr;
+        std::shared_ptr<const void> owner;  // Keeps the viewed grids alive; null when they are owned
+    };
+}
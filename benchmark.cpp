@@ -0,0 +1,784 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "GraphicsEngine.hpp"
+#include "GameLogic.hpp"
+#include "Settings.hpp"
+
+/*
+Headless renderer benchmark.
+
+Replays a fixed camera path through Settings::worldMap at several resolutions, rendering
+into the framebuffer only (no window, renderer or display needed), and reports frame time
+statistics plus rays per second. The checksum column hashes the last rendered frame, so
+output changes (or nondeterminism between thread counts and kernels) show up next to the timings.
+
+    benchmark [--frames N] [--warmup N] [--threads N] [--kernel scalar|sse2|avx2] [--res WxH]...
+              [--scene path|corridor|turn|static|hall|huge] [--walls flat|textured] [--mips on|off] [--texture-size N]
+              [--floor on|off] [--sprites N]... [--dda double|fixed] [--reuse on|off] [--skip on|off] [--verify]
+              [--budget MS] [--shading on|off] [--dither on|off] [--layout rowmajor|tiled|morton]
+              [--layouts] [--chunk-mb N] [--trace FILE]
+
+--scene corridor looks down a narrow corridor at a wall 20 cells away, where textured walls
+are drawn much smaller than their textures; compare --mips on and off there, with large
+textures (--texture-size 1024) to see the effect of the wall textures outgrowing the caches. On Linux the
+misses/frame column counts hardware cache misses of the render (perf_event_open, n/a when
+the kernel doesn't allow it).
+
+--sprites replaces the sprites of Settings with N randomly placed ones; repeat it to measure
+how frame times grow with the sprite count, e.g. --sprites 0 --sprites 1000 --sprites 5000.
+--scene turn stands still and turns, --scene static doesn't move at all; they show what
+reusing the last frame's wall hits saves (compare --reuse on and off).
+--dda fixed renders with the integer fixed point DDA. --skip on lets rays jump over open
+space; the steps/ray column shows the average DDA steps of the rays cast, and Mrays/s counts only
+those, not the columns reused from the last frame. --scene hall walks
+through a 256 x 256 hall with a pillar every 16 cells, where rays cross long stretches of open
+space. --scene huge streams a generated 65536 x 65536 map in chunks (see ChunkCache) while
+walking 1000 cells across it; the chunks line below each run shows what the cache loaded and
+evicted, and --chunk-mb sets its memory budget. Chunks arrive in the background, so that
+scene's checksum depends on how fast they load.
+--verify doesn't measure anything; it replays the path, corridor, turn and hall scenes
+at every resolution through the double DDA, the fixed point DDA, column reuse, empty space
+skipping, every map layout and a streamed copy of the map, and fails if any ray hits a
+different cell or side.
+--layout stores the map in that cell order. --layouts doesn't render either; it casts the rays
+of one frame (the first --res width) from the middle of a 4096 x 4096 map of scattered walls
+at 16 headings, in every layout, and prints the cast time per heading; --kernel and --dda pick
+the DDA and --frames the casts per heading.
+--budget turns on dynamic resolution with that frame time budget (off by default, so frames
+are comparable); the resolution column then shows where the render size ended up.
+--trace writes the measured frames to a Chrome trace JSON file (needs COOLGAME_PROFILE).
+*/
+
+namespace {
+    struct Resolution {
+        int width;
+        int height;
+    };
+
+    struct FrameStats {
+        double mean;
+        double p50;
+        double p99;
+        double max;
+    };
+
+    // Closed walk through open cells of Settings::worldMap
+    const double CAMERA_PATH[][2] = {
+        { 22.5, 12.5 }, { 12.5, 12.5 }, { 12.5, 3.5 }, { 2.5, 3.5 },
+        { 2.5, 21.5 }, { 14.5, 21.5 }, { 21.5, 21.5 }, { 22.5, 12.5 }
+    };
+    const int CAMERA_PATH_POINTS = sizeof(CAMERA_PATH) / sizeof(CAMERA_PATH[0]);
+
+    enum class Scene {
+        Path,
+        Corridor,
+        Turn,
+        Static,
+        Hall,
+        Huge
+    };
+
+    // Side of the hall scene's map
+    const int HALL_SIZE = 256;
+
+    // Side of the map --layouts casts in, large enough that its solid bits (2 MB) leave the L2
+    const int LARGE_MAP_SIZE = 4096;
+
+    // Side of the streamed map of the huge scene, 4 Gcells that are never all in memory
+    const int HUGE_MAP_SIZE = 65536;
+
+    /**
+     * Walls around a map of any size and one solid cell in 400 elsewhere, generated per chunk
+     * from a hash of the cell so chunks can load in any order.
+     */
+    class ScatteredChunkSource : public GameLogic::ChunkSource {
+    public:
+        explicit ScatteredChunkSource(int size)
+            : size(size) {}
+
+        int get_width() const override {
+            return size;
+        }
+
+        int get_height() const override {
+            return size;
+        }
+
+        void load(int chunkX, int chunkY, GameLogic::Chunk& chunk) const override {
+            for (int x = 0; x < GameLogic::Chunk::SIZE; x++) {
+                for (int y = 0; y < GameLogic::Chunk::SIZE; y++) {
+                    int cellX = (chunkX << GameLogic::Chunk::BITS) + x, cellY = (chunkY << GameLogic::Chunk::BITS) + y;
+                    if (cellX >= size || cellY >= size) continue;
+                    bool border = cellX == 0 || cellY == 0 || cellX == size - 1 || cellY == size - 1;
+                    if (border || hash(cellX, cellY) % 400 == 0) chunk.set(x, y, (cellX + cellY) % 5 + 1);
+                }
+            }
+        }
+
+    private:
+        static uint32_t hash(uint32_t x, uint32_t y) {
+            uint32_t h = x * 0x9E3779B1u ^ y * 0x85EBCA77u;
+            h ^= h >> 15;
+            h *= 0x2C1B3C6Du;
+            h ^= h >> 12;
+            return h;
+        }
+
+        int size;
+    };
+
+    /**
+     * Camera for a frame of the replay. The path is walked at constant speed per segment
+     * while the view sways left and right, so the rays sweep over near and far walls.
+     */
+    GameLogic::Camera camera_on_path(int frame, int frame_count) {
+        int segments = CAMERA_PATH_POINTS - 1;
+        double t = (frame / (double)frame_count) * segments;
+        int segment = std::min((int)t, segments - 1);
+        double f = t - segment;
+
+        const double* from = CAMERA_PATH[segment];
+        const double* to = CAMERA_PATH[segment + 1];
+        double posX = from[0] + (to[0] - from[0]) * f;
+        double posY = from[1] + (to[1] - from[1]) * f;
+
+        double heading = std::atan2(to[1] - from[1], to[0] - from[0]) + 0.6 * std::sin(frame * 0.05);
+        double dirX = std::cos(heading), dirY = std::sin(heading);
+
+        // Same field of view as the game's starting camera
+        return GameLogic::Camera{ posX, posY, dirX, dirY, dirY * 0.66, -dirX * 0.66 };
+    }
+
+    // Slowly walks x = 21.5 towards +y, between the walls at x = 20 and 22 and facing the far wall
+    GameLogic::Camera camera_in_corridor(int frame, int frame_count) {
+        double posY = 2.2 + 4.0 * frame / frame_count;
+        double heading = std::atan2(1.0, 0.0) + 0.05 * std::sin(frame * 0.05);
+        double dirX = std::cos(heading), dirY = std::sin(heading);
+        return GameLogic::Camera{ 21.5, posY, dirX, dirY, dirY * 0.66, -dirX * 0.66 };
+    }
+
+    // Turns on the spot at the start of the path, once around over the replay
+    GameLogic::Camera camera_turning(int frame, int frame_count) {
+        double heading = 4 * std::atan2(1.0, 0.0) * frame / frame_count;
+        double dirX = std::cos(heading), dirY = std::sin(heading);
+        return GameLogic::Camera{ CAMERA_PATH[0][0], CAMERA_PATH[0][1], dirX, dirY, dirY * 0.66, -dirX * 0.66 };
+    }
+
+    // Walks along the hall between two rows of pillars, looking along it and across it
+    GameLogic::Camera camera_in_hall(int frame, int frame_count) {
+        double posX = 8.5 + (HALL_SIZE - 17.0) * frame / frame_count;
+        double heading = 1.2 * std::sin(frame * 0.02);
+        double dirX = std::cos(heading), dirY = std::sin(heading);
+        return GameLogic::Camera{ posX, 24.5, dirX, dirY, dirY * 0.66, -dirX * 0.66 };
+    }
+
+    // Walls around the hall and a 2 x 2 pillar every 16 cells, in all five wall types
+    GameLogic::WorldMap hall_map() {
+        GameLogic::WorldMap map(HALL_SIZE, HALL_SIZE);
+        for (int i = 0; i < HALL_SIZE; i++) {
+            map.set(i, 0, 1);
+            map.set(i, HALL_SIZE - 1, 1);
+            map.set(0, i, 1);
+            map.set(HALL_SIZE - 1, i, 1);
+        }
+        for (int x = 16; x + 1 < HALL_SIZE - 1; x += 16) {
+            for (int y = 16; y + 1 < HALL_SIZE - 1; y += 16) {
+                int type = (x / 16 + y / 16) % 5 + 1;
+                map.set(x, y, type);
+                map.set(x + 1, y, type);
+                map.set(x, y + 1, type);
+                map.set(x + 1, y + 1, type);
+            }
+        }
+        return map;
+    }
+
+    /**
+     * Walls around a LARGE_MAP_SIZE square and one solid cell in 400 elsewhere, so rays from
+     * the middle cross a few hundred cells in any direction. Seeded like random_sprites.
+     */
+    GameLogic::WorldMap large_map(GameLogic::MapLayout layout) {
+        std::mt19937 rng(54321);
+        GameLogic::WorldMap map(LARGE_MAP_SIZE, LARGE_MAP_SIZE, layout);
+        for (int x = 0; x < LARGE_MAP_SIZE; x++) {
+            for (int y = 0; y < LARGE_MAP_SIZE; y++) {
+                bool border = x == 0 || y == 0 || x == LARGE_MAP_SIZE - 1 || y == LARGE_MAP_SIZE - 1;
+                if (border || rng() % 400 == 0) map.set(x, y, (x + y) % 5 + 1);
+            }
+        }
+        return map;
+    }
+
+    GameLogic::WorldMap scene_map(Scene scene) {
+        if (scene == Scene::Hall) return hall_map();
+        return GameLogic::WorldMap(&Settings::worldMap[0][0], Settings::MAP_WIDTH, Settings::MAP_HEIGHT);
+    }
+
+    // Walks 1000 cells along x through the middle of the huge map, swaying like in the hall
+    GameLogic::Camera camera_in_huge_map(int frame, int frame_count) {
+        double posX = HUGE_MAP_SIZE / 2 + 0.5 + 1000.0 * frame / frame_count;
+        double heading = 1.2 * std::sin(frame * 0.02);
+        double dirX = std::cos(heading), dirY = std::sin(heading);
+        return GameLogic::Camera{ posX, HUGE_MAP_SIZE / 2 + 0.5, dirX, dirY, dirY * 0.66, -dirX * 0.66 };
+    }
+
+    GameLogic::Camera scene_camera(Scene scene, int frame, int frame_count) {
+        switch (scene) {
+        case Scene::Huge:     return camera_in_huge_map(frame, frame_count);
+        case Scene::Corridor: return camera_in_corridor(frame, frame_count);
+        case Scene::Hall:     return camera_in_hall(frame, frame_count);
+        case Scene::Turn:     return camera_turning(frame, frame_count);
+        case Scene::Static:   return camera_on_path(0, frame_count);
+        default:              return camera_on_path(frame, frame_count);
+        }
+    }
+
+    const char* scene_name(Scene scene) {
+        switch (scene) {
+        case Scene::Corridor: return "corridor";
+        case Scene::Turn:     return "turn";
+        case Scene::Static:   return "static";
+        case Scene::Hall:     return "hall";
+        case Scene::Huge:     return "huge";
+        default:              return "path";
+        }
+    }
+
+    /**
+     * Hardware cache misses of this process, including threads started after open().
+     * Counts nothing where perf events are missing or not permitted.
+     */
+    class CacheMissCounter {
+    public:
+        ~CacheMissCounter() {
+#ifdef __linux__
+            if (fd >= 0) close(fd);
+#endif
+        }
+
+        bool open() {
+#ifdef __linux__
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+            return fd >= 0;
+#else
+            return false;
+#endif
+        }
+
+        void start() {
+#ifdef __linux__
+            if (fd < 0) return;
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+        }
+
+        // Misses since start(), or -1 without a counter
+        long long stop() {
+#ifdef __linux__
+            if (fd < 0) return -1;
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            long long count = 0;
+            if (read(fd, &count, sizeof(count)) != sizeof(count)) return -1;
+            return count;
+#else
+            return -1;
+#endif
+        }
+
+    private:
+        int fd = -1;
+    };
+
+    FrameStats compute_stats(std::vector<double> frame_ms) {
+        std::sort(frame_ms.begin(), frame_ms.end());
+
+        double sum = 0.0;
+        for (double ms : frame_ms) sum += ms;
+
+        auto percentile = [&](double p) {
+            size_t index = (size_t)std::ceil(p * frame_ms.size()) - 1;
+            return frame_ms[std::min(index, frame_ms.size() - 1)];
+        };
+
+        return FrameStats{ sum / frame_ms.size(), percentile(0.50), percentile(0.99), frame_ms.back() };
+    }
+
+    // FNV-1a over the pixels of a frame
+    Uint32 frame_checksum(const GraphicsEngine::FrameBuffer& frame) {
+        Uint32 hash = 2166136261u;
+        const Uint32* pixels = frame.data();
+        size_t count = (size_t)frame.get_width() * frame.get_height();
+        for (size_t i = 0; i < count; i++) {
+            hash = (hash ^ pixels[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    /**
+     * count sprites at random spots in open cells of Settings::worldMap. The generator is seeded
+     * and only its raw output is used, so every platform gets the same sprites.
+     */
+    std::vector<GameLogic::Sprite> random_sprites(int count) {
+        std::mt19937 rng(12345);
+        std::vector<GameLogic::Sprite> sprites;
+        while ((int)sprites.size() < count) {
+            int cellX = rng() % Settings::MAP_WIDTH, cellY = rng() % Settings::MAP_HEIGHT;
+            if (Settings::worldMap[cellX][cellY] != 0) continue;
+            double x = cellX + (rng() % 1000) / 1000.0, y = cellY + (rng() % 1000) / 1000.0;
+            sprites.push_back(GameLogic::Sprite{ x, y, (int)(rng() % 3) });
+        }
+        return sprites;
+    }
+
+    /**
+     * Golden camera path check of the fixed point DDA, of column reuse and of empty space skipping:
+     * every column of every frame of the scenes is cast with the scalar double DDA, then with the
+     * fixed point one, through a ColumnCache and with skipping. Counts the rays whose hit cell or
+     * side differ. Skipping is checked on both DDAs; the fixed point one has to match itself exactly.
+     */
+    struct VerifyResult {
+        long long rays = 0;
+        long long fixed_mismatches = 0;
+        long long reuse_mismatches = 0;
+        long long reused = 0;
+        long long skip_mismatches = 0;
+        long long layout_mismatches = 0;
+        long long chunk_mismatches = 0;
+    };
+
+    VerifyResult verify_hits(const Resolution& res, int frame_count) {
+        GameLogic::RayTable rays;
+        std::vector<GameLogic::RayHit> expected(res.width), actual(res.width);
+        VerifyResult result;
+
+        auto count_mismatches = [&]() {
+            long long mismatches = 0;
+            for (int x = 0; x < res.width; x++) {
+                if (expected[x].mapX != actual[x].mapX || expected[x].mapY != actual[x].mapY || expected[x].side != actual[x].side) {
+                    mismatches++;
+                }
+            }
+            return mismatches;
+        };
+
+        for (Scene scene : { Scene::Path, Scene::Corridor, Scene::Turn, Scene::Hall }) {
+            const GameLogic::WorldMap world = scene_map(scene);
+            const GameLogic::DistanceField distances(world);
+            const GameLogic::Raycaster raycaster(world);
+            const GameLogic::Raycaster skipping(world, &distances);
+            std::vector<GameLogic::RayHit> fixed(res.width);
+
+            // Every other layout of the map, cast with both DDAs
+            std::vector<GameLogic::WorldMap> layouts;
+            for (GameLogic::MapLayout layout : { GameLogic::MapLayout::Tiled, GameLogic::MapLayout::Morton }) {
+                layouts.push_back(world.relayout(layout));
+            }
+
+            // The same map streamed, with every chunk loaded up front
+            const int chunk_radius = (std::max(world.get_width(), world.get_height()) >> GameLogic::Chunk::BITS) + 1;
+            GameLogic::ChunkCache chunks(std::unique_ptr<const GameLogic::ChunkSource>(new GameLogic::WorldMapChunkSource(world)),
+                                         (size_t)1 << 30, chunk_radius, chunk_radius);
+            chunks.update(0, 0);
+            chunks.wait_idle();
+            chunks.update(0, 0);
+            const GameLogic::Raycaster streamed(chunks);
+
+            GameLogic::ColumnCache cache;
+            for (int frame = 0; frame < frame_count; frame++) {
+                GameLogic::Camera camera = scene_camera(scene, frame, frame_count);
+                rays.update(camera, res.width);
+                raycaster.cast_columns(camera, rays, 0, res.width, expected.data(), GraphicsEngine::SimdLevel::Scalar);
+
+                raycaster.cast_columns_fixed(camera, rays, 0, res.width, actual.data());
+                result.fixed_mismatches += count_mismatches();
+
+                skipping.cast_columns(camera, rays, 0, res.width, actual.data(), GraphicsEngine::SimdLevel::Scalar);
+                result.skip_mismatches += count_mismatches();
+                raycaster.cast_columns_fixed(camera, rays, 0, res.width, fixed.data());
+                skipping.cast_columns_fixed(camera, rays, 0, res.width, actual.data());
+                for (int x = 0; x < res.width; x++) {
+                    if (fixed[x].mapX != actual[x].mapX || fixed[x].mapY != actual[x].mapY || fixed[x].side != actual[x].side ||
+                        fixed[x].perpWallDist != actual[x].perpWallDist) {
+                        result.skip_mismatches++;
+                    }
+                }
+
+                for (const GameLogic::WorldMap& other : layouts) {
+                    const GameLogic::Raycaster relaid(other);
+                    relaid.cast_columns(camera, rays, 0, res.width, actual.data(), GraphicsEngine::SimdLevel::Scalar);
+                    result.layout_mismatches += count_mismatches();
+                    relaid.cast_columns(camera, rays, 0, res.width, actual.data(), GameLogic::Raycaster::default_kernel());
+                    result.layout_mismatches += count_mismatches();
+                    relaid.cast_columns_fixed(camera, rays, 0, res.width, actual.data());
+                    for (int x = 0; x < res.width; x++) {
+                        if (fixed[x].mapX != actual[x].mapX || fixed[x].mapY != actual[x].mapY || fixed[x].side != actual[x].side ||
+                            fixed[x].perpWallDist != actual[x].perpWallDist) {
+                            result.layout_mismatches++;
+                        }
+                    }
+                }
+
+                streamed.cast_columns(camera, rays, 0, res.width, actual.data(), GameLogic::Raycaster::default_kernel());
+                result.chunk_mismatches += count_mismatches();
+                streamed.cast_columns_fixed(camera, rays, 0, res.width, actual.data());
+                for (int x = 0; x < res.width; x++) {
+                    if (fixed[x].mapX != actual[x].mapX || fixed[x].mapY != actual[x].mapY || fixed[x].side != actual[x].side ||
+                        fixed[x].perpWallDist != actual[x].perpWallDist) {
+                        result.chunk_mismatches++;
+                    }
+                }
+
+                cache.begin_frame(camera, res.width, true);
+                for (int x = 0; x < res.width; x++) {
+                    if (cache.reuse(camera, rays, x, actual[x])) result.reused++;
+                    else actual[x] = expected[x];
+                    cache.store(x, actual[x]);
+                }
+                result.reuse_mismatches += count_mismatches();
+                result.rays += res.width;
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Cast time of width rays from the middle of the large map at 16 headings, per layout.
+     * Rays going along x walk the row-major bits with a stride of a whole map column, those
+     * along y walk them in order; the other layouts trade some of the latter for the former.
+     */
+    void compare_layouts(int width, int casts, GraphicsEngine::SimdLevel kernel, bool fixed_point) {
+        const GameLogic::MapLayout layouts[] = { GameLogic::MapLayout::RowMajor, GameLogic::MapLayout::Tiled, GameLogic::MapLayout::Morton };
+        const int HEADINGS = 16;
+
+        std::vector<GameLogic::WorldMap> maps;
+        for (GameLogic::MapLayout layout : layouts) maps.push_back(large_map(layout));
+
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "map: " << LARGE_MAP_SIZE << "x" << LARGE_MAP_SIZE << ", rays: " << width
+                  << ", kernel: " << (fixed_point ? "fixed" : GraphicsEngine::simd_level_name(kernel))
+                  << ", ms per cast" << std::endl;
+        std::cout << std::setw(9) << "degrees";
+        for (GameLogic::MapLayout layout : layouts) std::cout << std::setw(11) << GameLogic::map_layout_name(layout);
+        std::cout << std::endl;
+
+        GameLogic::RayTable rays;
+        std::vector<GameLogic::RayHit> hits(width);
+        std::vector<double> totals(maps.size(), 0.0);
+        for (int heading = 0; heading < HEADINGS; heading++) {
+            double angle = 8 * std::atan(1.0) * heading / HEADINGS;
+            double dirX = std::cos(angle), dirY = std::sin(angle);
+            double center = LARGE_MAP_SIZE / 2 + 0.5;
+            GameLogic::Camera camera{ center, center, dirX, dirY, dirY * 0.66, -dirX * 0.66 };
+            rays.update(camera, width);
+
+            std::cout << std::setw(9) << 360.0 * heading / HEADINGS;
+            for (size_t i = 0; i < maps.size(); i++) {
+                const GameLogic::Raycaster raycaster(maps[i]);
+                GraphicsEngine::Timer timer;
+                for (int cast = 0; cast < casts; cast++) {
+                    if (fixed_point) raycaster.cast_columns_fixed(camera, rays, 0, width, hits.data());
+                    else             raycaster.cast_columns(camera, rays, 0, width, hits.data(), kernel);
+                }
+                double ms = timer.get_elapsed_time() * 1000.0 / casts;
+                totals[i] += ms / HEADINGS;
+                std::cout << std::setw(11) << ms;
+            }
+            std::cout << std::endl;
+        }
+        std::cout << std::setw(9) << "mean";
+        for (double total : totals) std::cout << std::setw(11) << total;
+        std::cout << std::endl;
+    }
+
+    bool parse_scene(const char* name, Scene& scene) {
+        for (Scene candidate : { Scene::Path, Scene::Corridor, Scene::Turn, Scene::Static, Scene::Hall, Scene::Huge }) {
+            if (std::strcmp(name, scene_name(candidate)) == 0) {
+                scene = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool parse_kernel(const char* name, GraphicsEngine::SimdLevel& level) {
+        if (std::strcmp(name, "scalar") == 0) level = GraphicsEngine::SimdLevel::Scalar;
+        else if (std::strcmp(name, "sse2") == 0) level = GraphicsEngine::SimdLevel::SSE2;
+        else if (std::strcmp(name, "avx2") == 0) level = GraphicsEngine::SimdLevel::AVX2;
+        else return false;
+        return true;
+    }
+
+    void print_usage() {
+        std::cerr << "usage: benchmark [--frames N] [--warmup N] [--threads N] "
+                     "[--kernel scalar|sse2|avx2] [--res WxH]... [--scene path|corridor|turn|static|hall|huge] "
+                 "[--walls flat|textured] [--mips on|off] [--texture-size N] [--floor on|off] [--sprites N]... "
+                 "[--dda double|fixed] [--reuse on|off] [--skip on|off] [--verify] [--budget MS] "
+                 "[--shading on|off] [--dither on|off] [--layout rowmajor|tiled|morton] [--layouts] "
+                 "[--chunk-mb N] [--trace FILE]" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int frames = 500;
+    int warmup = 30;
+    int threads = Settings::RENDER_THREADS;
+    GraphicsEngine::SimdLevel kernel = GameLogic::Raycaster::default_kernel();
+    std::vector<Resolution> resolutions;
+    const char* trace_path = nullptr;
+    bool textured = Settings::TEXTURED_WALLS;
+    bool floor = Settings::FLOOR_CASTING;
+    bool mips = Settings::WALL_MIPMAPS;
+    int texture_size = Settings::TEXTURE_SIZE;
+    Scene scene = Scene::Path;
+    std::vector<int> sprite_counts;
+    bool fixed_point = Settings::FIXED_POINT_DDA;
+    bool verify = false;
+    bool reuse = Settings::COLUMN_REUSE;
+    bool skip = Settings::EMPTY_SPACE_SKIPPING;
+    double budget_ms = 0;
+    bool shading = Settings::DISTANCE_SHADING;
+    bool dither = Settings::SHADE_DITHERING;
+    GameLogic::MapLayout layout;
+    if (!GameLogic::parse_map_layout(Settings::MAP_LAYOUT, layout)) layout = GameLogic::MapLayout::RowMajor;
+    bool compare = false;
+    int chunk_mb = Settings::CHUNK_CACHE_MB;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--frames") == 0 && has_value) frames = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--warmup") == 0 && has_value) warmup = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--threads") == 0 && has_value) threads = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--kernel") == 0 && has_value && parse_kernel(argv[i + 1], kernel)) i++;
+        else if (std::strcmp(argv[i], "--trace") == 0 && has_value) trace_path = argv[++i];
+        else if (std::strcmp(argv[i], "--walls") == 0 && has_value &&
+                 (std::strcmp(argv[i + 1], "flat") == 0 || std::strcmp(argv[i + 1], "textured") == 0)) {
+            textured = std::strcmp(argv[++i], "textured") == 0;
+        }
+        else if (std::strcmp(argv[i], "--mips") == 0 && has_value &&
+                 (std::strcmp(argv[i + 1], "on") == 0 || std::strcmp(argv[i + 1], "off") == 0)) {
+            mips = std::strcmp(argv[++i], "on") == 0;
+        }
+        else if (std::strcmp(argv[i], "--texture-size") == 0 && has_value) texture_size = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--scene") == 0 && has_value && parse_scene(argv[i + 1], scene)) i++;
+        else if (std::strcmp(argv[i], "--reuse") == 0 && has_value &&
+                 (std::strcmp(argv[i + 1], "on") == 0 || std::strcmp(argv[i + 1], "off") == 0)) {
+            reuse = std::strcmp(argv[++i], "on") == 0;
+        }
+        else if (std::strcmp(argv[i], "--skip") == 0 && has_value &&
+                 (std::strcmp(argv[i + 1], "on") == 0 || std::strcmp(argv[i + 1], "off") == 0)) {
+            skip = std::strcmp(argv[++i], "on") == 0;
+        }
+        else if (std::strcmp(argv[i], "--floor") == 0 && has_value &&
+                 (std::strcmp(argv[i + 1], "on") == 0 || std::strcmp(argv[i + 1], "off") == 0)) {
+            floor = std::strcmp(argv[++i], "on") == 0;
+        }
+        else if (std::strcmp(argv[i], "--dda") == 0 && has_value &&
+                 (std::strcmp(argv[i + 1], "double") == 0 || std::strcmp(argv[i + 1], "fixed") == 0)) {
+            fixed_point = std::strcmp(argv[++i], "fixed") == 0;
+        }
+        else if (std::strcmp(argv[i], "--verify") == 0) verify = true;
+        else if (std::strcmp(argv[i], "--layouts") == 0) compare = true;
+        else if (std::strcmp(argv[i], "--chunk-mb") == 0 && has_value && std::atoi(argv[i + 1]) > 0) chunk_mb = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--layout") == 0 && has_value && GameLogic::parse_map_layout(argv[i + 1], layout)) i++;
+        else if (std::strcmp(argv[i], "--shading") == 0 && has_value &&
+                 (std::strcmp(argv[i + 1], "on") == 0 || std::strcmp(argv[i + 1], "off") == 0)) {
+            shading = std::strcmp(argv[++i], "on") == 0;
+        }
+        else if (std::strcmp(argv[i], "--dither") == 0 && has_value &&
+                 (std::strcmp(argv[i + 1], "on") == 0 || std::strcmp(argv[i + 1], "off") == 0)) {
+            dither = std::strcmp(argv[++i], "on") == 0;
+        }
+        else if (std::strcmp(argv[i], "--budget") == 0 && has_value) budget_ms = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--sprites") == 0 && has_value && std::atoi(argv[i + 1]) >= 0) {
+            sprite_counts.push_back(std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--res") == 0 && has_value) {
+            Resolution res;
+            if (std::sscanf(argv[++i], "%dx%d", &res.width, &res.height) != 2 || res.width <= 0 || res.height <= 0) {
+                print_usage();
+                return 1;
+            }
+            resolutions.push_back(res);
+        }
+        else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (frames <= 0) {
+        print_usage();
+        return 1;
+    }
+#ifdef COOLGAME_PROFILE
+    PROFILE_THREAD_NAME("main");
+    if (trace_path && !GraphicsEngine::Profiler::get().start_trace(trace_path)) {
+        std::cerr << "could not open trace file " << trace_path << std::endl;
+        return 1;
+    }
+#else
+    if (trace_path) {
+        std::cerr << "--trace needs a build with COOLGAME_PROFILE" << std::endl;
+        return 1;
+    }
+#endif
+    if (resolutions.empty()) {
+        resolutions = { { 640, 480 }, { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+    }
+
+    if (compare) {
+        compare_layouts(resolutions[0].width, frames, kernel, fixed_point);
+        return 0;
+    }
+
+    if (verify) {
+        long long total_mismatches = 0;
+        for (const Resolution& res : resolutions) {
+            VerifyResult result = verify_hits(res, frames);
+            std::cout << res.width << "x" << res.height << ": " << result.rays << " rays, "
+                      << result.fixed_mismatches << " fixed point hits, "
+                      << result.reuse_mismatches << " of " << result.reused << " reused hits and "
+                      << result.skip_mismatches << " skipping hits, "
+                      << result.layout_mismatches << " hits in other layouts and "
+                      << result.chunk_mismatches << " streamed hits differ from the double DDA" << std::endl;
+            total_mismatches += result.fixed_mismatches + result.reuse_mismatches + result.skip_mismatches +
+                                result.layout_mismatches + result.chunk_mismatches;
+        }
+        return total_mismatches == 0 ? 0 : 1;
+    }
+
+    // -1 keeps the sprites from Settings
+    if (sprite_counts.empty()) {
+        sprite_counts = { -1 };
+    }
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "frames: " << frames << ", scene: " << scene_name(scene)
+              << ", kernel: " << GraphicsEngine::simd_level_name(kernel)
+              << ", walls: " << (textured ? "textured" : "flat") << ", textures: " << texture_size
+              << ", mips: " << (mips ? "on" : "off")
+              << ", floor: " << (floor ? "on" : "off") << ", dda: " << (fixed_point ? "fixed" : "double")
+              << ", reuse: " << (reuse ? "on" : "off") << ", skip: " << (skip ? "on" : "off")
+              << ", shading: " << (shading ? (dither ? "dithered" : "on") : "off")
+              << ", layout: " << GameLogic::map_layout_name(layout) << std::endl;
+    std::cout << std::setw(11) << "resolution" << std::setw(8) << "threads" << std::setw(8) << "sprites"
+              << std::setw(10) << "mean ms" << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms"
+              << std::setw(10) << "max ms" << std::setw(12) << "Mrays/s" << std::setw(11) << "steps/ray"
+              << std::setw(14) << "misses/frame" << std::setw(12) << "checksum" << std::endl;
+
+    for (const Resolution& res : resolutions) {
+        for (int sprite_count : sprite_counts) {
+            // Opened before the game so its worker threads are counted too
+            CacheMissCounter cache_misses;
+            cache_misses.open();
+
+            GameLogic::Game* game = nullptr;
+            try {
+                // Always the built in map, whatever map file lies in the working directory
+                game = new GameLogic::Game(res.width, res.height, "benchmark", true, nullptr);
+            }
+            catch (const std::exception& e) {
+                std::cerr << e.what() << std::endl;
+                delete game;
+                return 1;
+            }
+            game->set_render_threads(threads);
+            game->set_ray_kernel(kernel);
+            game->set_fixed_point_dda(fixed_point);
+            game->set_column_reuse(reuse);
+            game->set_empty_space_skipping(skip);
+            if (scene == Scene::Hall) game->set_map(scene_map(scene).relayout(layout));
+            else if (layout != game->get_map().get_layout()) {
+                // The built in map in another layout keeps its lights
+                const GameLogic::WorldMap map = scene_map(scene).relayout(layout);
+                game->set_map(map, GameLogic::DistanceField(map), game->get_light_map());
+            }
+            if (scene == Scene::Huge) game->set_chunk_source(std::unique_ptr<const GameLogic::ChunkSource>(new ScatteredChunkSource(HUGE_MAP_SIZE)), chunk_mb);
+            game->set_frame_time_budget(budget_ms);
+            game->set_distance_shading(shading);
+            game->set_shade_dithering(dither);
+            game->set_textured_walls(textured);
+            game->set_floor_casting(floor);
+            game->set_wall_mipmaps(mips);
+            if (texture_size != game->get_texture_size() && !game->set_texture_size(texture_size)) {
+                std::cerr << "--texture-size must be a power of two" << std::endl;
+                delete game;
+                return 1;
+            }
+            if (sprite_count >= 0) {
+                game->set_sprites(random_sprites(sprite_count));
+            }
+
+            for (int frame = 0; frame < warmup; frame++) {
+                game->set_camera(scene_camera(scene, frame, frames));
+                game->render_frame();
+            }
+
+            std::vector<double> frame_ms;
+            frame_ms.reserve(frames);
+            GraphicsEngine::Timer frameTimer;
+            long long misses = 0;
+            double steps_per_ray = 0;
+            const long long rays_before = game->get_cast_rays();
+            for (int frame = 0; frame < frames; frame++) {
+                game->set_camera(scene_camera(scene, frame, frames));
+                cache_misses.start();
+                frameTimer.reset();
+                game->render_frame();
+                frame_ms.push_back(frameTimer.get_elapsed_time() * 1000.0);
+                steps_per_ray += game->get_steps_per_ray() / frames;
+                long long frame_misses = cache_misses.stop();
+                misses = (misses < 0 || frame_misses < 0) ? -1 : misses + frame_misses;
+            }
+
+            FrameStats stats = compute_stats(frame_ms);
+            // Rays actually cast; reused columns and skipped frames don't count
+            const double measured_seconds = stats.mean * frames / 1000.0;
+            double rays_per_second = measured_seconds > 0 ? (game->get_cast_rays() - rays_before) / measured_seconds : 0.0;
+
+            std::cout << std::setw(5) << game->get_render_width() << "x" << std::left << std::setw(5) << game->get_render_height() << std::right
+                      << std::setw(8) << game->get_render_threads() << std::setw(8) << game->get_sprites().size()
+                      << std::setw(10) << stats.mean << std::setw(10) << stats.p50 << std::setw(10) << stats.p99
+                      << std::setw(10) << stats.max << std::setw(12) << rays_per_second / 1e6 << std::setw(11) << steps_per_ray;
+            if (misses >= 0) std::cout << std::setw(14) << misses / frames;
+            else             std::cout << std::setw(14) << "n/a";
+            std::cout << "    " << std::hex << std::setw(8) << std::setfill('0') << frame_checksum(game->get_framebuffer())
+                      << std::dec << std::setfill(' ') << std::endl;
+            if (const GameLogic::ChunkCache* chunks = game->get_chunks()) {
+                std::cout << "    chunks: " << chunks->resident_count() << " resident (" << chunks->memory_used() / 1e6 << " MB), "
+                          << chunks->get_loads() << " loaded, " << chunks->get_evictions() << " evicted" << std::endl;
+            }
+
+            delete game;
+        }
+    }
+
+#ifdef COOLGAME_PROFILE
+    GraphicsEngine::Profiler::get().stop_trace();
+#endif
+    return 0;
+}
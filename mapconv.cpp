@@ -0,0 +1,208 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "MapFile.hpp"
+#include "Settings.hpp"
+
+/*
+Map converter: writes .cmap map files (see MapFile) and checks them.
+
+    mapconv [--layout rowmajor|tiled|morton] [--spawn X Y] (--settings | --text FILE | --generate SIZE) OUT.cmap
+    mapconv --check FILE.cmap
+
+--settings converts the built in Settings::worldMap. --text reads a map as text, one line per
+x like the rows of worldMap, with the wall types of the cells along y separated by spaces or
+commas; braces are ignored, so the rows of worldMap can be pasted as they are. --generate makes
+a SIZE x SIZE map with walls around it and one solid cell in 400 elsewhere, to try large maps.
+The player starts at --spawn, by default where the game starts it on the built in map, or in
+the middle of the first open cell.
+
+--check loads a map file the way the game does, reports how long that took, then reads every
+cell to make sure the materials, solid bits and distances agree.
+*/
+
+namespace {
+    bool read_text_map(const std::string& path, std::vector<int>& cells, int& width, int& height) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "can't read " << path << std::endl;
+            return false;
+        }
+
+        std::vector<std::vector<int>> rows;
+        std::string line;
+        while (std::getline(in, line)) {
+            for (char& c : line) {
+                if (c == ',' || c == '{' || c == '}') c = ' ';
+            }
+            std::istringstream fields(line);
+            std::vector<int> row;
+            std::string field;
+            while (fields >> field) {
+                char* end = nullptr;
+                long value = std::strtol(field.c_str(), &end, 10);
+                if (*end != '\0' || value < 0 || value > GameLogic::WorldMap::MAX_MATERIAL) {
+                    std::cerr << path << ": row " << rows.size() + 1 << ": '" << field << "' is not a wall type from 0 to "
+                              << GameLogic::WorldMap::MAX_MATERIAL << std::endl;
+                    return false;
+                }
+                row.push_back((int)value);
+            }
+            if (row.empty()) continue;
+            if (!rows.empty() && row.size() != rows[0].size()) {
+                std::cerr << path << ": row " << rows.size() + 1 << " has " << row.size() << " cells, the first one " << rows[0].size() << std::endl;
+                return false;
+            }
+            rows.push_back(row);
+        }
+        if (rows.empty()) {
+            std::cerr << path << ": no cells" << std::endl;
+            return false;
+        }
+
+        width = (int)rows.size();
+        height = (int)rows[0].size();
+        cells.clear();
+        for (const std::vector<int>& row : rows) cells.insert(cells.end(), row.begin(), row.end());
+        return true;
+    }
+
+    GameLogic::WorldMap generated_map(int size, GameLogic::MapLayout layout) {
+        std::mt19937 rng(54321);
+        GameLogic::WorldMap map(size, size, layout);
+        for (int x = 0; x < size; x++) {
+            for (int y = 0; y < size; y++) {
+                bool border = x == 0 || y == 0 || x == size - 1 || y == size - 1;
+                if (border || rng() % 400 == 0) map.set(x, y, (x + y) % 5 + 1);
+            }
+        }
+        return map;
+    }
+
+    bool first_open_cell(const GameLogic::WorldMap& map, double& x, double& y) {
+        for (int cellX = 0; cellX < map.get_width(); cellX++) {
+            for (int cellY = 0; cellY < map.get_height(); cellY++) {
+                if (!map.solid(cellX, cellY)) {
+                    x = cellX + 0.5;
+                    y = cellY + 0.5;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    int check(const std::string& path) {
+        auto start = std::chrono::steady_clock::now();
+        GameLogic::MapFile file;
+        std::string error;
+        bool loaded = GameLogic::MapFile::load(path, file, error);
+        double load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!loaded) {
+            std::cerr << (error.empty() ? "can't open " + path : error) << std::endl;
+            return 1;
+        }
+
+        const GameLogic::WorldMap& map = file.get_map();
+        std::cout << path << ": " << map.get_width() << "x" << map.get_height() << " cells, "
+                  << GameLogic::map_layout_name(map.get_layout()) << " layout, spawn " << file.get_spawn_x() << ", " << file.get_spawn_y()
+                  << (file.has_precomputed_distances() ? "" : ", distances computed on load") << std::endl;
+        std::cout << "loaded in " << load_ms << " ms" << std::endl;
+
+        if (!file.verify(error)) {
+            std::cerr << path << ": " << error << std::endl;
+            return 1;
+        }
+        std::cout << "all cells check out" << std::endl;
+        return 0;
+    }
+
+    void print_usage() {
+        std::cerr << "usage: mapconv [--layout rowmajor|tiled|morton] [--spawn X Y] "
+                     "(--settings | --text FILE | --generate SIZE) OUT.cmap\n"
+                     "       mapconv --check FILE.cmap" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    GameLogic::MapLayout layout = GameLogic::MapLayout::RowMajor;
+    bool has_spawn = false;
+    double spawnX = 0, spawnY = 0;
+    const char* text_path = nullptr;
+    bool settings = false;
+    int generate_size = 0;
+    const char* output = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--check") == 0 && has_value && argc == 3) return check(argv[++i]);
+        else if (std::strcmp(argv[i], "--layout") == 0 && has_value && GameLogic::parse_map_layout(argv[i + 1], layout)) i++;
+        else if (std::strcmp(argv[i], "--spawn") == 0 && i + 2 < argc) {
+            spawnX = std::atof(argv[++i]);
+            spawnY = std::atof(argv[++i]);
+            has_spawn = true;
+        }
+        else if (std::strcmp(argv[i], "--settings") == 0) settings = true;
+        else if (std::strcmp(argv[i], "--text") == 0 && has_value) text_path = argv[++i];
+        else if (std::strcmp(argv[i], "--generate") == 0 && has_value && std::atoi(argv[i + 1]) >= 3) generate_size = std::atoi(argv[++i]);
+        else if (!output && argv[i][0] != '-') output = argv[i];
+        else {
+            print_usage();
+            return 1;
+        }
+    }
+    if (!output || (settings ? 1 : 0) + (text_path ? 1 : 0) + (generate_size ? 1 : 0) != 1) {
+        print_usage();
+        return 1;
+    }
+
+    try {
+        GameLogic::WorldMap map;
+        if (settings) {
+            map = GameLogic::WorldMap(&Settings::worldMap[0][0], Settings::MAP_WIDTH, Settings::MAP_HEIGHT, layout);
+            if (!has_spawn) {
+                spawnX = Settings::SPAWN_X;
+                spawnY = Settings::SPAWN_Y;
+                has_spawn = true;
+            }
+        }
+        else if (text_path) {
+            std::vector<int> cells;
+            int width, height;
+            if (!read_text_map(text_path, cells, width, height)) return 1;
+            map = GameLogic::WorldMap(cells.data(), width, height, layout);
+        }
+        else {
+            map = generated_map(generate_size, layout);
+        }
+        if (!has_spawn && !first_open_cell(map, spawnX, spawnY)) {
+            std::cerr << "the map has no open cell to start in" << std::endl;
+            return 1;
+        }
+
+        GameLogic::MapFile::save(output, map, GameLogic::DistanceField(map), spawnX, spawnY);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // Written files are loaded back, so a map the game would refuse is reported here and not kept
+    GameLogic::MapFile file;
+    std::string error;
+    if (!GameLogic::MapFile::load(output, file, error)) {
+        std::cerr << (error.empty() ? std::string("can't open ") + output : error) << std::endl;
+        std::remove(output);
+        return 1;
+    }
+    std::cout << "wrote " << output << std::endl;
+    return 0;
+}
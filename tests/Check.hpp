@@ -0,0 +1,48 @@
+#pragma once
+#include <iostream>
+#include <vector>
+
+
+/*
+Minimal test registry for the tests executable. Every TEST_CASE(group, name) registers itself;
+tests/main.cpp runs all of them, or the groups named on the command line, and exits non-zero
+if any CHECK failed.
+*/
+namespace Tests {
+    struct Case {
+        const char* group;
+        const char* name;
+        void (*run)();
+    };
+
+    inline std::vector<Case>& cases() {
+        static std::vector<Case> all;
+        return all;
+    }
+
+    inline int& failures() {
+        static int count = 0;
+        return count;
+    }
+
+    inline void fail(const char* file, int line, const char* condition) {
+        std::cerr << file << ":" << line << ": CHECK(" << condition << ") failed" << std::endl;
+        failures()++;
+    }
+
+    struct Registration {
+        Registration(const char* group, const char* name, void (*run)()) {
+            cases().push_back(Case{ group, name, run });
+        }
+    };
+}
+
+#define TEST_CASE(group, name) \
+    static void group##_##name(); \
+    static const Tests::Registration group##_##name##_registration(#group, #name, group##_##name); \
+    static void group##_##name()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) Tests::fail(__FILE__, __LINE__, #condition); \
+    } while (0)
@@ -0,0 +1,32 @@
+#include <cstring>
+#include <iostream>
+
+#include "Check.hpp"
+
+/*
+Runs the test cases: all of them, or only the groups given as arguments.
+
+    tests [GROUP]...
+*/
+
+int main(int argc, char* argv[]) {
+    int run = 0;
+    for (const Tests::Case& test : Tests::cases()) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; i++) {
+            if (std::strcmp(argv[i], test.group) == 0) selected = true;
+        }
+        if (!selected) continue;
+
+        int failures_before = Tests::failures();
+        test.run();
+        std::cout << (Tests::failures() == failures_before ? "passed " : "FAILED ") << test.group << "." << test.name << std::endl;
+        run++;
+    }
+
+    if (run == 0) {
+        std::cerr << "no test cases selected" << std::endl;
+        return 1;
+    }
+    return Tests::failures() == 0 ? 0 : 1;
+}
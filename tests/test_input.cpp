@@ -0,0 +1,68 @@
+#include "GraphicsEngine.hpp"
+#include "Check.hpp"
+
+namespace {
+    typedef GraphicsEngine::StateManager<16> Keys;
+    using GraphicsEngine::KeyState;
+}
+
+TEST_CASE(input, press_and_release_edges) {
+    Keys keys;
+    keys.begin_frame();
+    CHECK(keys.check_change(true, 3) == KeyState::Pressed);
+    CHECK(keys.is_key_hold(3));
+    CHECK(keys.was_pressed(3));
+    CHECK(!keys.was_released(3));
+
+    // Held over the next frame: still down, but no new edge
+    keys.begin_frame();
+    CHECK(keys.check_change(true, 3) == KeyState::NoChange);
+    CHECK(keys.is_key_hold(3));
+    CHECK(!keys.was_pressed(3));
+
+    keys.begin_frame();
+    CHECK(keys.check_change(false, 3) == KeyState::Released);
+    CHECK(!keys.is_key_hold(3));
+    CHECK(keys.was_released(3));
+    CHECK(!keys.was_pressed(3));
+
+    keys.begin_frame();
+    CHECK(!keys.was_released(3));
+}
+
+TEST_CASE(input, tap_within_one_frame) {
+    Keys keys;
+    keys.begin_frame();
+    keys.check_change(true, 5);
+    keys.check_change(false, 5);
+
+    // Down and up before the frame read them: both edges are seen, the key isn't held
+    CHECK(keys.was_pressed(5));
+    CHECK(keys.was_released(5));
+    CHECK(!keys.is_key_hold(5));
+}
+
+TEST_CASE(input, codes_out_of_range) {
+    Keys keys;
+    CHECK(keys.check_change(true, -1) == KeyState::NoChange);
+    CHECK(keys.check_change(true, 16) == KeyState::NoChange);
+    CHECK(!keys.is_key_hold(16));
+    CHECK(!keys.was_pressed(-1));
+}
+
+TEST_CASE(input, snapshot_makes_edges) {
+    Keys keys;
+    Uint8 state[16] = {};
+    state[2] = 1;
+    keys.begin_frame();
+    keys.load_snapshot(state, 16);
+    CHECK(keys.is_key_hold(2));
+    CHECK(keys.was_pressed(2));
+
+    // A key released while its events were missed is released by the next snapshot
+    state[2] = 0;
+    keys.begin_frame();
+    keys.load_snapshot(state, 16);
+    CHECK(!keys.is_key_hold(2));
+    CHECK(keys.was_released(2));
+}
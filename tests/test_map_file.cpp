@@ -0,0 +1,190 @@
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "MapFile.hpp"
+#include "Check.hpp"
+
+namespace {
+    using GameLogic::MapFile;
+    using GameLogic::MapFileHeader;
+    using GameLogic::MapFileLayer;
+    using GameLogic::WorldMap;
+
+    const char* const VALID_PATH = "test_map_valid.cmap";
+    const char* const BROKEN_PATH = "test_map_broken.cmap";
+
+    // 8 x 8 cells with walls around them and a pillar at (4, 4)
+    WorldMap walled_map(GameLogic::MapLayout layout = GameLogic::MapLayout::RowMajor) {
+        WorldMap map(8, 8, layout);
+        for (int i = 0; i < 8; i++) {
+            map.set(i, 0, 1);
+            map.set(i, 7, 1);
+            map.set(0, i, 2);
+            map.set(7, i, 2);
+        }
+        map.set(4, 4, 3);
+        return map;
+    }
+
+    std::vector<char> read_file(const char* path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    void write_file(const char* path, const std::vector<char>& bytes) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), (std::streamsize)bytes.size());
+    }
+
+    std::vector<char> valid_file() {
+        const WorldMap map = walled_map();
+        MapFile::save(VALID_PATH, map, GameLogic::DistanceField(map), 2.5, 2.5);
+        return read_file(VALID_PATH);
+    }
+
+    // Loads bytes written to a file; whether it loaded, and the error
+    bool load_bytes(const std::vector<char>& bytes, std::string& error) {
+        write_file(BROKEN_PATH, bytes);
+        MapFile file;
+        bool loaded = MapFile::load(BROKEN_PATH, file, error);
+        std::remove(BROKEN_PATH);
+        return loaded;
+    }
+
+    bool rejected_with(const std::vector<char>& bytes, const char* reason) {
+        std::string error;
+        if (load_bytes(bytes, error)) return false;
+        return error.find(reason) != std::string::npos;
+    }
+
+    template <typename T>
+    void poke(std::vector<char>& bytes, size_t offset, T value) {
+        std::memcpy(bytes.data() + offset, &value, sizeof(value));
+    }
+
+    size_t layer_offset(int index) {
+        return sizeof(MapFileHeader) + index * sizeof(MapFileLayer);
+    }
+}
+
+TEST_CASE(map_file, round_trip) {
+    for (GameLogic::MapLayout layout : { GameLogic::MapLayout::RowMajor, GameLogic::MapLayout::Tiled, GameLogic::MapLayout::Morton }) {
+        const WorldMap map = walled_map(layout);
+        MapFile::save(VALID_PATH, map, GameLogic::DistanceField(map), 2.5, 3.5);
+
+        MapFile file;
+        std::string error;
+        CHECK(MapFile::load(VALID_PATH, file, error));
+        CHECK(error.empty());
+        CHECK(file.get_map().get_layout() == layout);
+        CHECK(file.get_map().get_width() == 8 && file.get_map().get_height() == 8);
+        CHECK(file.get_map().material(4, 4) == 3 && file.get_map().material(0, 3) == 2 && !file.get_map().solid(3, 3));
+        CHECK(file.has_precomputed_distances());
+        CHECK(file.get_spawn_x() == 2.5 && file.get_spawn_y() == 3.5);
+        CHECK(file.verify(error));
+    }
+    std::remove(VALID_PATH);
+}
+
+TEST_CASE(map_file, missing_file) {
+    MapFile file;
+    std::string error = "old";
+    CHECK(!MapFile::load("no_such_map.cmap", file, error));
+    CHECK(error.empty());
+}
+
+TEST_CASE(map_file, bad_magic_and_version) {
+    const std::vector<char> valid = valid_file();
+
+    std::vector<char> bytes = valid;
+    bytes[0] = 'X';
+    CHECK(rejected_with(bytes, "not a map file"));
+
+    bytes = valid;
+    poke<uint32_t>(bytes, offsetof(MapFileHeader, version), MapFile::VERSION + 1);
+    CHECK(rejected_with(bytes, "version"));
+
+    bytes.assign(valid.begin(), valid.begin() + 20);
+    CHECK(rejected_with(bytes, "too small"));
+    std::remove(VALID_PATH);
+}
+
+TEST_CASE(map_file, truncated_layer_table) {
+    std::vector<char> bytes = valid_file();
+    bytes.resize(layer_offset(1) + 4);
+    CHECK(rejected_with(bytes, "layer table out of the file"));
+
+    // A layer pointing past the end of the file
+    bytes = valid_file();
+    bytes.resize(bytes.size() - 1);
+    CHECK(rejected_with(bytes, "out of the file"));
+    std::remove(VALID_PATH);
+}
+
+TEST_CASE(map_file, misaligned_and_wrong_size_layers) {
+    const std::vector<char> valid = valid_file();
+
+    std::vector<char> bytes = valid;
+    MapFileLayer layer;
+    std::memcpy(&layer, bytes.data() + layer_offset(1), sizeof(layer));
+    poke<uint64_t>(bytes, layer_offset(1) + offsetof(MapFileLayer, offset), layer.offset + 8);
+    CHECK(rejected_with(bytes, "is not aligned"));
+
+    bytes = valid;
+    poke<uint64_t>(bytes, layer_offset(1) + offsetof(MapFileLayer, size), layer.size - 1);
+    CHECK(rejected_with(bytes, "wrong size"));
+
+    // Dropping the material layer from the table
+    bytes = valid;
+    poke<uint32_t>(bytes, offsetof(MapFileHeader, layer_count), 1);
+    CHECK(rejected_with(bytes, "layer missing"));
+    std::remove(VALID_PATH);
+}
+
+TEST_CASE(map_file, open_border) {
+    WorldMap map = walled_map();
+    map.set(0, 5, 0);
+    MapFile::save(BROKEN_PATH, map, GameLogic::DistanceField(map), 2.5, 2.5);
+    std::string error;
+    MapFile file;
+    CHECK(!MapFile::load(BROKEN_PATH, file, error));
+    CHECK(error.find("border cells must be solid") != std::string::npos);
+    std::remove(BROKEN_PATH);
+}
+
+TEST_CASE(map_file, spawn_checks) {
+    const WorldMap map = walled_map();
+    MapFile::save(BROKEN_PATH, map, GameLogic::DistanceField(map), 4.5, 4.5);
+    std::string error;
+    MapFile file;
+    CHECK(!MapFile::load(BROKEN_PATH, file, error));
+    CHECK(error.find("spawn point inside a wall") != std::string::npos);
+
+    MapFile::save(BROKEN_PATH, map, GameLogic::DistanceField(map), 0.5, 2.5);
+    CHECK(!MapFile::load(BROKEN_PATH, file, error));
+    CHECK(error.find("spawn point off the map") != std::string::npos);
+    std::remove(BROKEN_PATH);
+}
+
+TEST_CASE(map_file, verify_catches_bad_distances) {
+    std::vector<char> bytes = valid_file();
+    MapFileLayer distances;
+    std::memcpy(&distances, bytes.data() + layer_offset(2), sizeof(distances));
+    CHECK(distances.type == (uint32_t)GameLogic::MapLayer::Distances);
+    bytes[distances.offset + 3 * 8 + 3] = 100;  // Cell (3, 3), next to the pillar
+
+    // Loading trusts the layer; verify() doesn't
+    write_file(BROKEN_PATH, bytes);
+    MapFile file;
+    std::string error;
+    CHECK(MapFile::load(BROKEN_PATH, file, error));
+    CHECK(!file.verify(error));
+    CHECK(error.find("distance layer") != std::string::npos);
+    std::remove(BROKEN_PATH);
+    std::remove(VALID_PATH);
+}
@@ -0,0 +1,63 @@
+#include "ResolutionController.hpp"
+#include "Check.hpp"
+
+namespace {
+    using GraphicsEngine::ResolutionController;
+
+    // Adds a whole window of frames of frame_ms; returns whether the scale changed at its end
+    bool add_window(ResolutionController& resolution, double frame_ms) {
+        bool changed = false;
+        for (int i = 0; i < ResolutionController::WINDOW_FRAMES; i++) {
+            changed = resolution.add_frame(frame_ms);
+            if (i + 1 < ResolutionController::WINDOW_FRAMES) CHECK(!changed);
+        }
+        return changed;
+    }
+}
+
+TEST_CASE(resolution, no_budget_keeps_full_size) {
+    ResolutionController resolution;
+    CHECK(!add_window(resolution, 100.0));
+    CHECK(resolution.get_scale() == 1.0);
+    CHECK(resolution.scaled(800) == 800);
+}
+
+TEST_CASE(resolution, steps_down_over_budget) {
+    ResolutionController resolution;
+    resolution.set_budget(10.0);
+    CHECK(add_window(resolution, 12.0));
+    CHECK(resolution.get_scale() == ResolutionController::STEPS[1]);
+    CHECK(resolution.scaled(800) == 720);
+
+    // One step per window, down to the smallest scale and no further
+    for (int i = 0; i < ResolutionController::STEP_COUNT; i++) add_window(resolution, 50.0);
+    CHECK(resolution.get_scale() == ResolutionController::STEPS[ResolutionController::STEP_COUNT - 1]);
+    CHECK(!add_window(resolution, 50.0));
+}
+
+TEST_CASE(resolution, hysteresis) {
+    ResolutionController resolution;
+    resolution.set_budget(10.0);
+    add_window(resolution, 12.0);
+
+    // 9 ms fits the budget, but at the larger scale it would be predicted at 9 / 0.81 = 11.1 ms
+    CHECK(!add_window(resolution, 9.0));
+    CHECK(resolution.get_scale() == ResolutionController::STEPS[1]);
+
+    // 6 / 0.81 = 7.4 ms is inside the 80% headroom, so it steps back up
+    CHECK(add_window(resolution, 6.0));
+    CHECK(resolution.get_scale() == 1.0);
+}
+
+TEST_CASE(resolution, set_budget_resets) {
+    ResolutionController resolution;
+    resolution.set_budget(10.0);
+    add_window(resolution, 20.0);
+    CHECK(resolution.get_scale() < 1.0);
+
+    // The frames of a partial window are forgotten too
+    for (int i = 0; i < ResolutionController::WINDOW_FRAMES - 1; i++) resolution.add_frame(20.0);
+    resolution.set_budget(10.0);
+    CHECK(resolution.get_scale() == 1.0);
+    CHECK(!resolution.add_frame(20.0));
+}
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "WorkerPool.hpp"
+#include "Check.hpp"
+
+namespace {
+    typedef std::vector<std::pair<int, int>> Bands;
+
+    // Bands of one parallel_for over [0, count), sorted, checking every index is handled exactly once
+    Bands run_counted(GraphicsEngine::WorkerPool& pool, int count) {
+        std::unique_ptr<std::atomic<int>[]> calls(new std::atomic<int>[std::max(count, 1)]);
+        for (int i = 0; i < count; i++) calls[i] = 0;
+        std::mutex mutex;
+        Bands bands;
+
+        pool.parallel_for(count, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) calls[i]++;
+            std::lock_guard<std::mutex> lock(mutex);
+            bands.push_back({ begin, end });
+        });
+
+        for (int i = 0; i < count; i++) CHECK(calls[i] == 1);
+        std::sort(bands.begin(), bands.end());
+        return bands;
+    }
+}
+
+TEST_CASE(worker_pool, bands_cover_the_range) {
+    GraphicsEngine::WorkerPool pool(4);
+    CHECK(pool.get_thread_count() == 4);
+
+    Bands bands = run_counted(pool, 1000);
+    CHECK(bands.size() == (size_t)(4 * GraphicsEngine::WorkerPool::BANDS_PER_THREAD));
+    CHECK(!bands.empty() && bands.front().first == 0 && bands.back().second == 1000);
+    for (size_t i = 0; i < bands.size(); i++) {
+        CHECK(bands[i].first < bands[i].second);
+        if (i > 0) CHECK(bands[i].first == bands[i - 1].second);
+    }
+}
+
+TEST_CASE(worker_pool, fewer_items_than_bands) {
+    GraphicsEngine::WorkerPool pool(4);
+    Bands bands = run_counted(pool, 3);
+    CHECK(bands.size() == 3);
+
+    bool called = false;
+    pool.parallel_for(0, [&](int, int) { called = true; });
+    CHECK(!called);
+}
+
+TEST_CASE(worker_pool, reuse_gives_the_same_bands) {
+    GraphicsEngine::WorkerPool pool(3);
+    const Bands first = run_counted(pool, 777);
+    for (int round = 0; round < 200; round++) {
+        CHECK(run_counted(pool, 777) == first);
+        run_counted(pool, 1 + round * 7);
+    }
+}
+
+TEST_CASE(worker_pool, thread_count_changes) {
+    GraphicsEngine::WorkerPool pool(2);
+    run_counted(pool, 500);
+
+    pool.set_thread_count(6);
+    CHECK(pool.get_thread_count() == 6);
+    CHECK(run_counted(pool, 500).size() == (size_t)(6 * GraphicsEngine::WorkerPool::BANDS_PER_THREAD));
+
+    // A single thread runs the whole range in one call on the caller
+    pool.set_thread_count(1);
+    CHECK(pool.get_thread_count() == 1);
+    CHECK(run_counted(pool, 500) == Bands({ { 0, 500 } }));
+}